@@ -101,6 +101,7 @@ pub fn build(b: *std.Build) !void {
         }
     }
     options.addOption([]const []const u8, "zigApps", try zigApps.toOwnedSlice());
+    options.addOption(bool, "isr_cycles", b.option(bool, "isr-cycles", "Time every TIM15_IRQ for the Benchmarks app, always on in Debug") orelse false);
     // TODO:
     // Auto-generate index file
 
@@ -127,7 +128,8 @@ pub fn build(b: *std.Build) !void {
     const openocdPath = try std.fs.path.resolve(b.allocator, &.{ homePath, ".platformio", "packages", "tool-openocd", "bin" });
     //std.debug.print("Home dir: {s}\nOpenocd dir: {s}\n", .{ homePath, openocdPath });
     defer b.allocator.free(openocdPath);
-    const openocd = try b.findProgram(&.{"openocd"}, &.{openocdPath});
+    // Steps that don't touch the board shouldn't need openocd installed
+    const openocd = b.findProgram(&.{"openocd"}, &.{openocdPath}) catch "openocd";
 
     // Absolute path to openocd.cfg
     const openocdcfg = b.path("build/openocd.cfg").getPath(b);
@@ -165,4 +167,99 @@ pub fn build(b: *std.Build) !void {
     firmware_check.app_mod.addOptions("options", options);
     const check = b.step("check", "Check if firmware compiles");
     check.dependOn(&firmware_check.artifact.step);
+
+    // ---------
+    // Host tests
+    // ---------
+    // Everything in here only depends on std, so it runs on the machine doing the build
+    const host_tests = b.addTest(.{
+        .root_source_file = b.path("src/hostTests.zig"),
+        .target = b.host,
+        .optimize = optimize,
+    });
+    const run_host_tests = b.addRunArtifact(host_tests);
+    const test_step = b.step("test", "Run the std-only subsystem tests on the host");
+    test_step.dependOn(&run_host_tests.step);
+
+    // ---------
+    // Host tools for uart logs
+    // ---------
+    const jitter_report = b.addExecutable(.{
+        .name = "bam-jitter-report",
+        .root_source_file = b.path("tools/bamJitterReport.zig"),
+        .target = b.host,
+        .optimize = optimize,
+    });
+    jitter_report.root_module.addImport("bamJitter", b.createModule(.{
+        .root_source_file = b.path("src/util/bamJitter.zig"),
+    }));
+    const run_jitter_report = b.addRunArtifact(jitter_report);
+    if (b.args) |args| {
+        run_jitter_report.addArgs(args);
+    }
+    const jitter_step = b.step("bam-jitter", "Print the BAM jitter report from a uart log: zig build bam-jitter -- uart.log");
+    jitter_step.dependOn(&run_jitter_report.step);
+
+    const replay_trace = b.addExecutable(.{
+        .name = "replay-trace",
+        .root_source_file = b.path("tools/replayTrace.zig"),
+        .target = b.host,
+        .optimize = optimize,
+    });
+    replay_trace.root_module.addImport("replay", b.createModule(.{
+        .root_source_file = b.path("src/replay.zig"),
+    }));
+    const run_replay_trace = b.addRunArtifact(replay_trace);
+    if (b.args) |args| {
+        run_replay_trace.addArgs(args);
+    }
+    const replay_step = b.step("replay", "Replay a recorded trace from a uart log on the host: zig build replay -- uart.log");
+    replay_step.dependOn(&run_replay_trace.step);
+
+    // ---------
+    // M0 benchmarks, no board needed
+    // ---------
+    // The pure kernels from src/benchKernels.zig as thumbv6m code, run on QEMU's micro:bit (a Cortex-M0).
+    // -icount makes SysTick count instructions, see tools/benchM0.zig
+    const bench_m0 = b.addExecutable(.{
+        .name = "bench-m0",
+        .root_source_file = b.path("tools/benchM0.zig"),
+        .target = b.resolveTargetQuery(.{
+            .cpu_arch = .thumb,
+            .cpu_model = .{ .explicit = &std.Target.arm.cpu.cortex_m0 },
+            .os_tag = .freestanding,
+            .abi = .eabi,
+        }),
+        // Same as the firmware that gets flashed
+        .optimize = .ReleaseSmall,
+        // The report reads the code sizes out of the symbol table
+        .strip = false,
+    });
+    bench_m0.root_module.addImport("kernels", b.createModule(.{
+        .root_source_file = b.path("src/benchKernels.zig"),
+    }));
+    bench_m0.setLinkerScript(b.path("tools/benchM0.ld"));
+    bench_m0.entry = .{ .symbol_name = "benchReset" };
+
+    const qemu = b.addSystemCommand(&.{ "qemu-system-arm", "-M", "microbit", "-display", "none", "-monitor", "none", "-serial", "none", "-icount", "shift=7", "-chardev" });
+    // Semihosting output goes into a file, so nothing QEMU itself prints can get mixed in
+    const bench_m0_out = qemu.addPrefixedOutputFileArg("file,id=bench,path=", "bench-m0.out");
+    qemu.addArgs(&.{ "-semihosting-config", "enable=on,target=native,chardev=bench", "-kernel" });
+    qemu.addArtifactArg(bench_m0);
+
+    const bench_m0_report = b.addExecutable(.{
+        .name = "bench-m0-report",
+        .root_source_file = b.path("tools/benchM0Report.zig"),
+        .target = b.host,
+        .optimize = optimize,
+    });
+    const run_bench_m0_report = b.addRunArtifact(bench_m0_report);
+    run_bench_m0_report.addArtifactArg(bench_m0);
+    run_bench_m0_report.addFileArg(bench_m0_out);
+    run_bench_m0_report.addArg(b.pathFromRoot("tools/benchM0Baseline.zig"));
+    if (b.args) |args| {
+        run_bench_m0_report.addArgs(args);
+    }
+    const bench_m0_step = b.step("bench-m0", "Instruction counts and code size of the hot paths on an emulated M0 (needs qemu-system-arm), -- --record to rewrite the baseline");
+    bench_m0_step.dependOn(&run_bench_m0_report.step);
 }
@@ -2,9 +2,23 @@
 #include "stm32f091xc.h"
 #include <stdint.h>
 
+void adc_begin(void);
+int adc_try_enable(void);
+void adc_finish(uint32_t(*outVecAddr)[2]);
+
 void init_adc(uint32_t(*outVecAddr)[2])
 {
+    adc_begin();
+    while (!adc_try_enable())
+    {
+    }
+    adc_finish(outVecAddr);
+}
 
+// Non-blocking version of init_adc, split at the two clock/enable waits.
+// adc_begin(), then call adc_try_enable() until it returns 1, then adc_finish()
+void adc_begin(void)
+{
     RCC->AHBENR |= RCC_AHBENR_GPIOCEN;
     RCC->APB2ENR |= RCC_APB2ENR_ADC1EN;
 
@@ -17,18 +31,28 @@ void init_adc(uint32_t(*outVecAddr)[2])
     GPIOC->PUPDR &= ~GPIO_PUPDR_PUPDR2;
     GPIOC->PUPDR |= GPIO_PUPDR_PUPDR2_1;
 
-    // enabling HSI14 and waiting for stability
+    // enabling HSI14, stability is checked in adc_try_enable
     RCC->CR2 |= RCC_CR2_HSI14ON;
-    while ((RCC->CR2 & RCC_CR2_HSI14RDY) == 0)
+}
+
+// Returns 1 once HSI14 is stable and the ADC is enabled and ready
+int adc_try_enable(void)
+{
+    if ((RCC->CR2 & RCC_CR2_HSI14RDY) == 0)
     {
+        return 0;
     }
 
     // enabling ADC and waiting for stability
-    ADC1->CR |= ADC_CR_ADEN;
-    while ((ADC1->ISR & ADC_ISR_ADRDY) == 0)
+    if ((ADC1->CR & ADC_CR_ADEN) == 0)
     {
+        ADC1->CR |= ADC_CR_ADEN;
     }
+    return (ADC1->ISR & ADC_ISR_ADRDY) != 0;
+}
 
+void adc_finish(uint32_t(*outVecAddr)[2])
+{
     // turning off the channels
     ADC1->CR &= ~(ADC_CR_ADSTART);
 
@@ -234,12 +234,27 @@ void init_lcd_spi()
     sdcard_io_high_speed();
 }
 
-// sets up LCD
-void LCD_Setup() {
+// spi and pins for the LCD, all pins low
+static void lcd_prepare(void)
+{
     init_lcd_spi();
     tft_select(0);
     tft_reset(0);
     tft_reg_select(0);
+}
+
+// picks the pin handlers (0 for the board's own) and selects the LCD
+static void lcd_attach(void (*reset)(int), void (*select)(int), void (*reg_select)(int))
+{
+    lcddev.reset = reset ? reset : tft_reset;
+    lcddev.select = select ? select : tft_select;
+    lcddev.reg_select = reg_select ? reg_select : tft_reg_select;
+    lcddev.select(1);
+}
+
+// sets up LCD
+void LCD_Setup() {
+    lcd_prepare();
     LCD_Init(tft_reset, tft_select, tft_reg_select);
 }
 
@@ -265,17 +280,31 @@ void LCD_WR_DATA(uint8_t data)
 // Sets up / initializes the entire LCD, NECESSARY
 void LCD_Init(void (*reset)(int), void (*select)(int), void (*reg_select)(int))
 {
-    lcddev.reset = tft_reset;
-    lcddev.select = tft_select;
-    lcddev.reg_select = tft_reg_select;
-    if (reset)
-        lcddev.reset = reset;
-    if (select)
-        lcddev.select = select;
-    if (reg_select)
-        lcddev.reg_select = reg_select;
-    lcddev.select(1);
+    lcd_attach(reset, select, reg_select);
     LCD_Reset();
+    LCD_SendInitSequence();
+    nano_wait(120000000); // Wait 120 ms
+    LCD_FinishInit();
+}
+
+// Non-blocking LCD bring-up, used by the boot sequence instead of LCD_Setup.
+// Same steps as LCD_Setup, with the waits left to the caller:
+// LCD_BeginReset, 100 ms, LCD_EndReset, 50 ms, LCD_SendInitSequence, 120 ms, LCD_FinishInit
+void LCD_BeginReset(void)
+{
+    lcd_prepare();
+    lcd_attach(0, 0, 0);
+    lcddev.reset(1);
+}
+
+void LCD_EndReset(void)
+{
+    lcddev.reset(0);
+}
+
+// Register setup, ending with the exit sleep command. Needs 120 ms before LCD_FinishInit
+void LCD_SendInitSequence(void)
+{
     // Initialization sequence for 2.2inch ILI9341
     LCD_WR_REG(0xCF);
     LCD_WR_DATA(0x00);
@@ -374,7 +403,10 @@ void LCD_Init(void (*reset)(int), void (*select)(int), void (*reg_select)(int))
     LCD_WR_DATA(0x00);
     LCD_WR_DATA(0xef);
     LCD_WR_REG(0x11);     // Exit Sleep
-    nano_wait(120000000); // Wait 120 ms
+}
+
+void LCD_FinishInit(void)
+{
     LCD_WR_REG(0x29);     // Display on
 
     LCD_direction(0);
@@ -59,6 +59,55 @@ typedef struct {
 extern void setPixel(int32_t x, int32_t y, int32_t z, uint16_t color);
 extern void clearFrame(uint16_t color);
 extern void matrixRender();
+
+// 24-bit colour (0xRRGGBB), gamma corrected and dithered over the BAM planes.
+// Call enableBAM() before the first renderRgb() and disableBAM() before returning to the menu.
+extern void enableBAM();
+extern void disableBAM();
+extern void setPixelRgb(int32_t x, int32_t y, int32_t z, uint32_t rgb);
+extern void clearFrameRgb(uint32_t rgb);
+extern void renderRgb();
+
+// Batched drawing. Each call appends one command to a list (128 max, returns false when full),
+// and drawSubmit() draws the whole list in one pass and renders it.
+// Commands draw in the order they were added.
+#define AXIS_X 0
+#define AXIS_Y 1
+#define AXIS_Z 2
+extern bool drawVoxel(int32_t x, int32_t y, int32_t z, uint16_t color);
+// len voxels from (x, y, z) along axis. Returns false for anything but AXIS_X, AXIS_Y or AXIS_Z
+extern bool drawSpan(int32_t x, int32_t y, int32_t z, uint8_t axis, int32_t len, uint16_t color);
+// Filled box, both corners inclusive
+extern bool drawBox(int32_t x0, int32_t y0, int32_t z0, int32_t x1, int32_t y1, int32_t z1, uint16_t color);
+extern bool drawLine(int32_t x0, int32_t y0, int32_t z0, int32_t x1, int32_t y1, int32_t z1, uint16_t color);
+// Radius above 15, or a centre far off the cube, takes one list entry per layer it covers
+extern bool drawSphere(int32_t x, int32_t y, int32_t z, int32_t radius, uint16_t color);
+// 8x8 bitmap on layer z. Byte x of bits, bit y set = draw (x, y)
+extern bool drawBlit(int32_t z, uint64_t bits, uint16_t color);
+extern bool drawClear(uint16_t color);
+extern void drawSubmit();
+
+// Turns everything render() shows to one of the 24 ways the cube can sit.
+// index = up * 4 + yaw, with up going +z, -z, +x, -x, +y, -y. 0 is the cube as built. Anything >= 24 is ignored.
+// Auto picks up from the accelerometer each time the app calls updateAutoOrientation() (IMU must be initialized),
+// yaw turns about up in quarter turns.
+extern void setOrientation(uint8_t index);
+extern void setAutoOrientation(bool on);
+extern void updateAutoOrientation();
+extern void setOrientationYaw(uint8_t quarters);
+
+// Input-to-photon latency in ms, over the last 128 button/joystick edges an app read.
+// input: edge -> app read it, display: app read it -> next frame scanned onto the cube, total: both.
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t avg;
+    uint32_t p99;
+    uint32_t max;
+} LatencyStats;
+extern void getInputLatency(LatencyStats* input, LatencyStats* display, LatencyStats* total);
+extern void resetInputLatency();
+
 extern void dtStart(DeltaTime* dt);
 extern bool joystickPressed();
 extern bool joystickMovedRight();
@@ -20,6 +20,10 @@ void internal_clock();
 void nano_wait(int t);
 void LCD_Setup(void);
 void LCD_Init(void (*reset)(int), void (*select)(int), void (*reg_select)(int));
+void LCD_BeginReset(void);
+void LCD_EndReset(void);
+void LCD_SendInitSequence(void);
+void LCD_FinishInit(void);
 void LCD_Clear(u16 Color);
 void LCD_DrawPoint(u16 x,u16 y,u16 c);
 void LCD_DrawLine(u16 x1, u16 y1, u16 x2, u16 y2, u16 c);
@@ -9,6 +9,9 @@ const FpInt = imu.AngleFpInt;
 const buttonA = @import("../subsystems/button_a.zig");
 const fp = @import("../util/fixedPoint.zig");
 const UartDebug = @import("../util/uartDebug.zig");
+const BamJitter = @import("../util/bamJitter.zig");
+const cycles = @import("../util/cycles.zig");
+const buildMode = @import("builtin").mode;
 const BAMint = matrix.BAM_int;
 
 pub const app: Application = .{
@@ -20,25 +23,44 @@ pub const app: Application = .{
 };
 
 fn render() callconv(.C) void {
+    const prevProfile = matrix.getProfile();
+    matrix.requestProfile(&matrix.profiles.bam32_60hz);
     matrix.enableBAM();
 
     matrix.clearFrameBAM(.{ .r = 0, .g = 0, .b = 0 });
 
     for (1..8) |i| {
         const iu3: u3 = @intCast(i);
-        matrix.setPixelBAM(iu3, 0, 0, .{ .r = 7 - (iu3 - 1), .g = 0, .b = 0 });
-        matrix.setPixelBAM(0, iu3, 0, .{ .r = 0, .g = 7 - (iu3 - 1), .b = 0 });
-        matrix.setPixelBAM(0, 0, iu3, .{ .r = 0, .g = 0, .b = 7 - (iu3 - 1) });
+        // Brightest next to the corner, dimmest at the far end
+        const level: BAMint = @intCast(math.maxInt(BAMint) * (8 - i) / 7);
+        matrix.setPixelBAM(iu3, 0, 0, .{ .r = level, .g = 0, .b = 0 });
+        matrix.setPixelBAM(0, iu3, 0, .{ .r = 0, .g = level, .b = 0 });
+        matrix.setPixelBAM(0, 0, iu3, .{ .r = 0, .g = 0, .b = level });
     }
     matrix.setPixelBAM(0, 0, 0, .{ .r = math.maxInt(BAMint), .g = math.maxInt(BAMint), .b = math.maxInt(BAMint) });
 
     matrix.renderBAM();
+    var measuring = false;
     while (true) {
         // get input
         if (joystick.button_pressed()) {
             break;
         }
+        // Up captures how long the planes really are. Debug builds dump the capture and its report over uart
+        if (joystick.moved_up() and !measuring) {
+            cycles.init();
+            BamJitter.capture.start(matrix.getProfile().lsb_time_us);
+            measuring = true;
+        }
+        if (measuring and BamJitter.capture.done()) {
+            measuring = false;
+            if (buildMode == .Debug) {
+                BamJitter.capture.dump(UartDebug.writer) catch {};
+                BamJitter.analyze(BamJitter.capture.captured(), BamJitter.capture.lsb_time_us).print(UartDebug.writer) catch {};
+            }
+        }
     }
 
     matrix.disableBAM();
+    matrix.requestProfile(prevProfile);
 }
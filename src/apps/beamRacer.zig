@@ -0,0 +1,74 @@
+/// beamRacer.zig
+/// Demo for matrix.startStreaming. There's no frame buffer at all: each layer of a rolling wave
+/// gets computed in the DMA interrupt right before it's shifted out.
+const Application = @import("../cImport.zig").Application;
+const std = @import("std");
+const deltaTime = @import("../subsystems/deltaTime.zig");
+const matrix = @import("../subsystems/matrix.zig");
+const joystick = @import("../subsystems/joystick.zig");
+
+pub const app: Application = .{
+    .renderFn = &appMain,
+
+    .name = "Beam Racer",
+    .authorfirst = "Cube",
+    .authorlast = "Team",
+};
+
+// Written by the app loop, read by the producer in the DMA interrupt
+var phaseRaw: u32 = 0;
+const phase: *volatile u32 = @volatileCast(&phaseRaw);
+
+// Wave height for x + y + phase, bouncing 0..7..0
+const heights: [14]u3 = genHeights: {
+    var h: [14]u3 = undefined;
+    for (0..14) |i| {
+        h[i] = if (i < 8) i else 14 - i;
+    }
+    break :genHeights h;
+};
+
+const colors = [8]matrix.Led{
+    .{ .r = 0, .g = 0, .b = 1 },
+    .{ .r = 0, .g = 1, .b = 1 },
+    .{ .r = 0, .g = 1, .b = 0 },
+    .{ .r = 1, .g = 1, .b = 0 },
+    .{ .r = 1, .g = 0, .b = 0 },
+    .{ .r = 1, .g = 0, .b = 1 },
+    .{ .r = 1, .g = 1, .b = 1 },
+    .{ .r = 1, .g = 1, .b = 1 },
+};
+
+fn produceLayer(z: u3, layer: *matrix.LayerData) void {
+    const t = phase.*;
+    const pattern = matrix.rowPattern(colors[z]);
+    for (0..8) |r| {
+        // Row r holds x = 7 - r, voxel i holds y = 7 - i
+        const x = 7 - r;
+        var mask: u32 = 0;
+        for (0..8) |i| {
+            const y = 7 - i;
+            if (heights[(x + y + t) % heights.len] == z) {
+                mask |= @as(u32, 0b111) << @intCast(3 * i);
+            }
+        }
+        layer.setRow(@intCast(r), pattern & mask);
+    }
+}
+
+fn appMain() callconv(.C) void {
+    var dt: deltaTime.DeltaTime = .{};
+    dt.start();
+    const stepTime: u32 = 80;
+    var sinceStep: u32 = 0;
+
+    matrix.startStreaming(&produceLayer, &matrix.profiles.streaming);
+    while (!joystick.button_pressed()) {
+        sinceStep += dt.milli();
+        if (sinceStep >= stepTime) {
+            sinceStep = 0;
+            phase.* +%= 1;
+        }
+    }
+    matrix.stopStreaming();
+}
@@ -0,0 +1,159 @@
+/// benchmarks.zig
+/// Cycle counts for the firmware's hot paths, measured on the M0 itself with SysTick.
+/// Each kernel runs a few times and keeps its fastest run, which gets compared against the baseline below.
+/// The cube ends up green if nothing got more than `tolerance_pct` slower, red if something did,
+/// and blue if some kernel has no baseline yet.
+/// Debug builds print every result over uart, in the same form as the baseline table,
+/// so a new baseline is a copy & paste away. Re-record it whenever a change is meant to cost cycles.
+/// The kernels that don't need the cube also run without one, under QEMU: zig build bench-m0.
+const Application = @import("../cImport.zig").Application;
+const std = @import("std");
+const buildMode = @import("builtin").mode;
+const matrix = @import("../subsystems/matrix.zig");
+const joystick = @import("../subsystems/joystick.zig");
+const DrawList = @import("../subsystems/drawList.zig");
+const Color = @import("../subsystems/color.zig");
+const Kernels = @import("../benchKernels.zig");
+const cExport = @import("../cExport.zig");
+const cycles = @import("../util/cycles.zig");
+const UartDebug = @import("../util/uartDebug.zig");
+
+pub const app: Application = .{
+    .renderFn = &appMain,
+
+    .name = "Benchmarks",
+    .authorfirst = "Cube",
+    .authorlast = "Team",
+};
+
+const tolerance_pct = 10;
+const runs = 8;
+
+const Baseline = struct { name: []const u8, cycles: u32 };
+/// Fastest run of each kernel, ReleaseSmall, 48 MHz, 1 flash wait state
+const baseline = [_]Baseline{};
+
+// ---------
+// Kernels
+// ---------
+// The pure ones are in benchKernels.zig, shared with zig build bench-m0. These need the cube
+
+// Everything Color.render() does per frame except waiting for the frame to be shown
+fn colorDither() void {
+    Color.dither();
+}
+
+// What a C app drawing a 6x6x6 box costs: one call into Zig per voxel, or one command and a batched pass.
+// Through a var so the calls don't get inlined, like they can't be from C
+var setPixelFfi: *const fn (i32, i32, i32, u16) callconv(.C) void = &cExport.setPixel;
+var boxColor: u16 = 0b101;
+
+fn ffiBox() void {
+    var x: i32 = 1;
+    while (x <= 6) : (x += 1) {
+        var y: i32 = 1;
+        while (y <= 6) : (y += 1) {
+            var z: i32 = 1;
+            while (z <= 6) : (z += 1) {
+                setPixelFfi(x, y, z, boxColor);
+            }
+        }
+    }
+}
+
+fn batchedBox() void {
+    _ = cExport.drawBox(1, 1, 1, 6, 6, 6, boxColor);
+    DrawList.shared.execute(matrix.getDrawBuffer());
+    DrawList.shared.reset();
+}
+
+const Rate = Kernels.Rate;
+const Kernel = Kernels.Kernel;
+const kernels = Kernels.kernels ++ [_]Kernel{
+    .{ .name = "Color dither frame", .run = &colorDither },
+    .{ .name = "setPixel FFI box 6x6x6", .run = &ffiBox },
+    .{ .name = "drawBox+execute 6x6x6", .run = &batchedBox },
+};
+
+fn fastest(comptime kernel: Kernel) u32 {
+    var best: u32 = std.math.maxInt(u32);
+    for (0..runs) |_| {
+        best = @min(best, cycles.measure(kernel.run, .{}));
+    }
+    return best;
+}
+
+/// Worst TIM15_IRQ over a second of 8-level BAM
+fn bamIsr() u32 {
+    const prevProfile = matrix.getProfile();
+    matrix.requestProfile(&matrix.profiles.bam8_80hz);
+    matrix.BAM_isrCycles = .{};
+    matrix.enableBAM();
+    // ~1 s at 48 MHz, SysTick wraps every ~349 ms so count it in pieces
+    for (0..4) |_| {
+        const start = cycles.now();
+        while (cycles.since(start) < 12_000_000) {}
+    }
+    matrix.disableBAM();
+    matrix.requestProfile(prevProfile);
+    return matrix.BAM_isrCycles.max;
+}
+
+const Verdict = enum { ok, regressed, no_baseline };
+
+fn judge(name: []const u8, measured: u32) Verdict {
+    for (baseline) |b| {
+        if (std.mem.eql(u8, b.name, name)) {
+            return if (@as(u64, measured) * 100 > @as(u64, b.cycles) * (100 + tolerance_pct)) .regressed else .ok;
+        }
+    }
+    return .no_baseline;
+}
+
+fn report(name: []const u8, measured: u32, rate: ?Rate, worst: *Verdict) void {
+    const verdict = judge(name, measured);
+    if (@intFromEnum(verdict) > @intFromEnum(worst.*)) {
+        worst.* = verdict;
+    }
+    if (buildMode == .Debug) {
+        UartDebug.printIfDebug("    .{{ .name = \"{s}\", .cycles = {} }}, // {s}", .{
+            name,
+            measured,
+            switch (verdict) {
+                .ok => "ok",
+                .regressed => "REGRESSION",
+                .no_baseline => "new",
+            },
+        }) catch {};
+        if (rate) |r| {
+            UartDebug.printIfDebug(", {} {s}/s", .{ @as(u64, r.items) * matrix.sysclock_hz / @max(measured, 1), r.what }) catch {};
+        }
+        UartDebug.printIfDebug("\n", .{}) catch {};
+    }
+}
+
+fn appMain() callconv(.C) void {
+    cycles.init();
+    var worst = Verdict.ok;
+
+    // Show something is happening, the BAM part alone takes a second
+    matrix.clearFrame(.{ .r = 1, .g = 1, .b = 0 });
+    matrix.render();
+
+    inline for (kernels) |kernel| {
+        report(kernel.name, fastest(kernel), kernel.rate, &worst);
+    }
+    // TIM15_IRQ only times itself in Debug or with -Disr-cycles=true
+    if (matrix.track_isr_cycles) {
+        report("TIM15_IRQ worst", bamIsr(), null, &worst);
+    }
+
+    matrix.clearFrame(switch (worst) {
+        .ok => .{ .r = 0, .g = 1, .b = 0 },
+        .regressed => .{ .r = 1, .g = 0, .b = 0 },
+        .no_baseline => .{ .r = 0, .g = 0, .b = 1 },
+    });
+    matrix.render();
+
+    while (!joystick.button_pressed()) {}
+}
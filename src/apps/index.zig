@@ -19,6 +19,10 @@ pub const zigApps = [_]*const Application{
     &@import("cvm.zig").app,
     &@import("bamTest.zig").app,
     &@import("gamecube.zig").app,
+    &@import("beamRacer.zig").app,
+    &@import("benchmarks.zig").app,
+    &@import("lifeSand.zig").app,
+    &@import("meshViewer.zig").app,
 };
 
 // comptime {
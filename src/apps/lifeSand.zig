@@ -0,0 +1,61 @@
+/// lifeSand.zig
+/// Demo for the automaton subsystem. Left/right switches between 3D Life, sand and water,
+/// the button exits. Sand and water fall whichever way the IMU says is down.
+/// The app itself is in logic/lifeSand.zig, this hooks it up to the cube.
+const Application = @import("../cImport.zig").Application;
+const deltaTime = @import("../subsystems/deltaTime.zig");
+const matrix = @import("../subsystems/matrix.zig");
+const joystick = @import("../subsystems/joystick.zig");
+const imu = @import("../subsystems/imu.zig");
+const Logic = @import("logic/lifeSand.zig");
+
+pub const app: Application = .{
+    .renderFn = &appMain,
+
+    .name = Logic.name,
+    .authorfirst = "Cube",
+    .authorlast = "Team",
+};
+
+/// Every read goes through the subsystems' Trace hooks, so sessions can be recorded and replayed
+const CubeIo = struct {
+    dt: deltaTime.DeltaTime = .{},
+
+    pub fn seed(_: *CubeIo) u32 {
+        return deltaTime.timestamp();
+    }
+
+    pub fn buttonPressed(_: *CubeIo) bool {
+        return joystick.button_pressed();
+    }
+
+    pub fn movedLeft(_: *CubeIo) bool {
+        return joystick.moved_left();
+    }
+
+    pub fn movedRight(_: *CubeIo) bool {
+        return joystick.moved_right();
+    }
+
+    pub fn milli(self: *CubeIo) u32 {
+        return self.dt.milli();
+    }
+
+    pub fn gravity(_: *CubeIo) [3]i16 {
+        return imu.readGravity();
+    }
+
+    pub fn frame(_: *CubeIo) *matrix.FrameBuffer {
+        return matrix.getDrawBuffer();
+    }
+
+    pub fn render(_: *CubeIo) void {
+        matrix.render();
+    }
+};
+
+fn appMain() callconv(.C) void {
+    var io = CubeIo{};
+    io.dt.start();
+    Logic.run(&io);
+}
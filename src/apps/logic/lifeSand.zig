@@ -0,0 +1,140 @@
+/// lifeSand.zig
+/// What the Life & Sand app does, without any of the hardware. Everything from outside comes through io,
+/// so the same code runs on the cube (apps/lifeSand.zig) and against a trace on Linux (zig build replay).
+/// io needs seed(), buttonPressed(), movedLeft(), movedRight() and milli(), like the subsystems it stands for,
+/// gravity() in raw accelerometer counts, and frame() & render() for the draw buffer.
+/// Not in apps/ itself since build.zig takes every file in there for an app.
+const std = @import("std");
+const Automaton = @import("../../subsystems/automaton.zig");
+const FrameBufferTypes = @import("../../subsystems/frameBuffer.zig");
+const FrameBuffer = FrameBufferTypes.FrameBuffer;
+const Led = FrameBufferTypes.Led;
+const Grid = Automaton.Grid;
+
+/// In the menu, and in the header of traces recorded from it
+pub const name = "Life & Sand";
+
+const Mode = enum { life, sand, water };
+
+/// Generations per second
+const life_rate = 4;
+const sand_rate = 15;
+/// Grains stop pouring in once this many are in the cube
+const max_grains = 200;
+/// Life gets reseeded after this many generations without changing
+const stale_limit = 6;
+
+const layerColors = [8]Led{
+    .{ .r = 1, .g = 0, .b = 0 },
+    .{ .r = 1, .g = 1, .b = 0 },
+    .{ .r = 0, .g = 1, .b = 0 },
+    .{ .r = 0, .g = 1, .b = 1 },
+    .{ .r = 0, .g = 0, .b = 1 },
+    .{ .r = 1, .g = 0, .b = 1 },
+    .{ .r = 1, .g = 1, .b = 1 },
+    .{ .r = 1, .g = 0, .b = 0 },
+};
+
+fn seedLife(rand: std.Random) Grid {
+    // About a third full, away from the walls
+    var g = Grid{};
+    for (1..7) |x| {
+        for (1..7) |y| {
+            for (1..7) |z| {
+                g.set(@intCast(x), @intCast(y), @intCast(z), rand.uintLessThan(u8, 3) == 0);
+            }
+        }
+    }
+    return g;
+}
+
+/// Drops a grain in near the middle of the face opposite down
+fn pour(g: *Grid, down: Automaton.Dir, rand: std.Random) void {
+    var p = [3]i32{ 3 + rand.intRangeAtMost(i32, 0, 1), 3 + rand.intRangeAtMost(i32, 0, 1), 0 };
+    // Shuffle so the face's own axis ends up in the right slot
+    const a = down.axis();
+    p[2] = p[a];
+    p[a] = if (down.negative()) 7 else 0;
+    g.set(p[0], p[1], p[2], true);
+}
+
+fn draw(frame: *FrameBuffer, g: *const Grid, mode: Mode) void {
+    // Same as matrix.clearFrame() to black
+    for (&frame.layers) |*layer| {
+        for (0..8) |r| {
+            layer.setRow(@intCast(r), 0);
+        }
+    }
+    switch (mode) {
+        .life => {
+            // One colour per layer, painted a layer at a time
+            for (layerColors, 0..) |color, z| {
+                var layer = Grid{};
+                layer.layers[z] = g.layers[z];
+                Automaton.paint(frame, &layer, color);
+            }
+        },
+        .sand => Automaton.paint(frame, g, .{ .r = 1, .g = 1, .b = 0 }),
+        .water => Automaton.paint(frame, g, .{ .r = 0, .g = 0, .b = 1 }),
+    }
+}
+
+/// Runs until the button gets pressed
+pub fn run(io: anytype) void {
+    var prng = std.rand.DefaultPrng.init(io.seed());
+    const rand = prng.random();
+
+    var sinceStep: u32 = 0;
+
+    var mode = Mode.life;
+    var grid = seedLife(rand);
+    var prev = Grid{};
+    var stale: u32 = 0;
+    var gen: u32 = 0;
+    var down = Automaton.Dir.neg_z;
+
+    while (!io.buttonPressed()) {
+        const left = io.movedLeft();
+        if (left or io.movedRight()) {
+            const count = @typeInfo(Mode).Enum.fields.len;
+            const step: usize = if (left) count - 1 else 1;
+            mode = @enumFromInt((@intFromEnum(mode) + step) % count);
+            grid = if (mode == .life) seedLife(rand) else Grid{};
+            stale = 0;
+        }
+
+        sinceStep += io.milli();
+        const stepTime: u32 = 1000 / @as(u32, if (mode == .life) life_rate else sand_rate);
+        if (sinceStep < stepTime) {
+            continue;
+        }
+        sinceStep = 0;
+        gen +%= 1;
+
+        switch (mode) {
+            .life => {
+                const next = Automaton.lifeStep(&grid, Automaton.rules.life4555);
+                // Dead, still, or blinking between two states
+                const same = std.mem.eql(u64, &next.layers, &grid.layers) or std.mem.eql(u64, &next.layers, &prev.layers);
+                stale = if (same or next.count() == 0) stale + 1 else 0;
+                prev = grid;
+                grid = if (stale >= stale_limit) seedLife(rand) else next;
+                if (stale >= stale_limit) {
+                    stale = 0;
+                }
+            },
+            .sand, .water => {
+                // Only read on generations, which milli() gates, so a replay reads it just as often
+                if (Automaton.downFrom(io.gravity())) |d| {
+                    down = d;
+                }
+                if (grid.count() < max_grains) {
+                    pour(&grid, down, rand);
+                }
+                grid = Automaton.sandStep(&grid, down, if (mode == .sand) .sand else .water, gen);
+            },
+        }
+        draw(io.frame(), &grid, mode);
+        io.render();
+    }
+}
@@ -0,0 +1,80 @@
+/// traceIo.zig
+/// io for the app logic in this directory when it runs off the cube. Every read goes through the same
+/// Trace hook the subsystem it stands for uses, in the same order, so a trace recorded on the cube
+/// replays here and checks every frame against the recorded CRCs.
+/// The live values come from a Script, which only matters when recording on the host.
+const std = @import("std");
+const Trace = @import("../../util/trace.zig");
+const FrameBuffer = @import("../../subsystems/frameBuffer.zig").FrameBuffer;
+
+pub const Script = struct {
+    seed: u32 = 0,
+    /// What every milli() call says went by
+    step_ms: u32 = 1,
+    /// Raw accelerometer counts, 16384 = 1 g
+    gravity: [3]i16 = .{ 0, 0, -16384 },
+    /// Passes through the app's loop (buttonPressed() calls) to move the joystick on
+    left: []const u32 = &.{},
+    right: []const u32 = &.{},
+    /// Pass the button gets pressed on, which ends the app. Pressed from the start by default,
+    /// so a replay that desyncs (and goes back to live values) ends there
+    exit: u32 = 0,
+};
+
+pub const TraceIo = struct {
+    script: Script = .{},
+    frameBuffer: FrameBuffer = .{},
+    /// Frames rendered so far
+    frames: u32 = 0,
+    passes: u32 = 0,
+
+    pub fn seed(self: *TraceIo) u32 {
+        return Trace.seed(self.script.seed);
+    }
+
+    pub fn buttonPressed(self: *TraceIo) bool {
+        defer self.passes += 1;
+        return Trace.input(.joystick_button, self.passes >= self.script.exit);
+    }
+
+    pub fn movedLeft(self: *TraceIo) bool {
+        return Trace.input(.joystick_left, self.onThisPass(self.script.left));
+    }
+
+    pub fn movedRight(self: *TraceIo) bool {
+        return Trace.input(.joystick_right, self.onThisPass(self.script.right));
+    }
+
+    pub fn milli(self: *TraceIo) u32 {
+        return Trace.time(self.script.step_ms);
+    }
+
+    /// Same bytes and byte order as imu.readGravity() reads off the ICM
+    pub fn gravity(self: *TraceIo) [3]i16 {
+        var data: [6]u8 = undefined;
+        for (self.script.gravity, 0..) |g, i| {
+            std.mem.writeInt(i16, data[2 * i ..][0..2], g, .big);
+        }
+        Trace.imu(&data);
+        return .{
+            std.mem.readInt(i16, data[0..2], .big),
+            std.mem.readInt(i16, data[2..4], .big),
+            std.mem.readInt(i16, data[4..6], .big),
+        };
+    }
+
+    pub fn frame(self: *TraceIo) *FrameBuffer {
+        return &self.frameBuffer;
+    }
+
+    /// Where matrix.render() hands the frame to Trace
+    pub fn render(self: *TraceIo) void {
+        Trace.frame(std.mem.asBytes(&self.frameBuffer));
+        self.frames += 1;
+    }
+
+    fn onThisPass(self: *const TraceIo, passes: []const u32) bool {
+        // buttonPressed() has already counted this pass
+        return std.mem.indexOfScalar(u32, passes, self.passes - 1) != null;
+    }
+};
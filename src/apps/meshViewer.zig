@@ -0,0 +1,56 @@
+/// meshViewer.zig
+/// Shows the meshes in src/models, held still in the room while the cube turns around them.
+/// Left/right switches model, up switches between surface and solid, down makes the current way up the model's,
+/// the button exits.
+const Application = @import("../cImport.zig").Application;
+const matrix = @import("../subsystems/matrix.zig");
+const joystick = @import("../subsystems/joystick.zig");
+const imu = @import("../subsystems/imu.zig");
+const Automaton = @import("../subsystems/automaton.zig");
+const Voxelizer = @import("../subsystems/voxelizer.zig");
+const models = @import("../models/models.zig");
+
+pub const app: Application = .{
+    .renderFn = &appMain,
+
+    .name = "Mesh Viewer",
+    .authorfirst = "Cube",
+    .authorlast = "Team",
+};
+
+const colors = [2]matrix.Led{
+    .{ .r = 0, .g = 1, .b = 1 },
+    .{ .r = 1, .g = 0, .b = 1 },
+};
+
+fn appMain() callconv(.C) void {
+    var model: usize = 0;
+    var mode = Voxelizer.Mode.surface;
+    imu.zeroOrientation();
+
+    while (!joystick.button_pressed()) {
+        if (joystick.moved_right()) {
+            model = (model + 1) % models.all.len;
+        }
+        if (joystick.moved_left()) {
+            model = (model + models.all.len - 1) % models.all.len;
+        }
+        if (joystick.moved_up()) {
+            mode = if (mode == .surface) .solid else .surface;
+        }
+        if (joystick.moved_down()) {
+            imu.zeroOrientation();
+        }
+
+        imu.updateOrientation();
+        // Undo the cube's turn, so the model keeps its place in the room
+        const xf = Voxelizer.Transform.fromRotor(imu.getZeroedOrientation().conjugate(), Voxelizer.unit);
+        var grid = Voxelizer.Grid{};
+        Voxelizer.voxelize(models.all[model], &xf, mode, &grid);
+
+        const frame = matrix.getDrawBuffer();
+        matrix.clearFrame(.{ .r = 0, .g = 0, .b = 0 });
+        Automaton.paint(frame, &grid, colors[model % colors.len]);
+        matrix.render();
+    }
+}
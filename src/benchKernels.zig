@@ -0,0 +1,136 @@
+/// benchKernels.zig
+/// The hot paths both benchmark runners time: the Benchmarks app on the cube (SysTick cycles)
+/// and zig build bench-m0 in QEMU (instructions and code size, tools/benchM0.zig).
+/// Nothing in here touches a register, so the same code runs on a board, under an emulator and on the host.
+/// Sits in src/ itself so it can be a module root that reaches the subsystems.
+const std = @import("std");
+const FrameBufferTypes = @import("subsystems/frameBuffer.zig");
+const imu = @import("subsystems/imu.zig");
+const DrawList = @import("subsystems/drawList.zig");
+const Compositor = @import("subsystems/compositor.zig");
+const Orientation = @import("subsystems/orientation.zig");
+const Automaton = @import("subsystems/automaton.zig");
+const Voxelizer = @import("subsystems/voxelizer.zig");
+const models = @import("models/models.zig");
+
+/// Kernels that do a known amount of work per run also get it printed as a rate
+pub const Rate = struct { items: u32, what: []const u8 };
+pub const Kernel = struct { name: []const u8, run: *const fn () void, rate: ?Rate = null };
+
+// Inputs live in vars so nothing gets folded at compile time
+var frame: FrameBufferTypes.FrameBuffer = .{};
+var frame2: FrameBufferTypes.FrameBuffer = .{};
+var color = FrameBufferTypes.Led{ .r = 1, .g = 0, .b = 1 };
+var rotor = imu.AngleRotor.identity();
+var vec = imu.AccelVec{
+    .x = imu.AccelFpInt.fromFloat(0.25),
+    .y = imu.AccelFpInt.fromFloat(-0.5),
+    .z = imu.AccelFpInt.fromFloat(0.8),
+};
+var gyro = imu.AngleVec{
+    .x = imu.AngleFpInt.fromFloat(0.01),
+    .y = imu.AngleFpInt.fromFloat(-0.02),
+    .z = imu.AngleFpInt.fromFloat(0.005),
+};
+var list: DrawList.DrawList = .{};
+var surfA: Compositor.Surface = .{};
+var surfB: Compositor.Surface = .{};
+var orientationIndex: u5 = 13;
+var grid = Automaton.Grid.dissolve(100);
+var down = Automaton.Dir.neg_z;
+var meshTransform = Voxelizer.Transform.identity();
+
+fn setPixelAll() void {
+    for (0..8) |x| {
+        for (0..8) |y| {
+            for (0..8) |z| {
+                frame.set_pixel(@intCast(x), @intCast(y), @intCast(z), color);
+            }
+        }
+    }
+}
+
+fn clearFrame() void {
+    frame.clear(color);
+}
+
+fn rotateVector() void {
+    std.mem.doNotOptimizeAway(rotor.rotateVector(vec));
+}
+
+fn imuFuse() void {
+    std.mem.doNotOptimizeAway(imu.fuse(rotor, gyro, vec, 5));
+}
+
+fn drawListBoxes() void {
+    list.reset();
+    _ = list.clear(.{ .r = 0, .g = 0, .b = 0 });
+    _ = list.box(1, 1, 1, 6, 6, 6, color);
+    _ = list.sphere(4, 4, 4, 2, .{ .r = 0, .g = 1, .b = 0 });
+    list.execute(&frame);
+}
+
+fn compositorOver() void {
+    surfA.over(&surfB, &Compositor.Mask.all);
+}
+
+fn compositorDissolve() void {
+    Compositor.transitionFrame(&surfA, &surfB, .dissolve, 128, &surfA);
+}
+
+fn orientationRemap() void {
+    Orientation.remap(&frame, &frame2, &Orientation.plans[orientationIndex]);
+}
+
+fn lifeGeneration() void {
+    grid = Automaton.lifeStep(&grid, Automaton.rules.life4555);
+}
+
+fn sandGeneration() void {
+    grid = Automaton.sandStep(&grid, down, .water, 0);
+}
+
+fn voxelizeSurface() void {
+    var out = Voxelizer.Grid{};
+    Voxelizer.voxelize(&models.torus, &meshTransform, .surface, &out);
+    std.mem.doNotOptimizeAway(out);
+}
+
+fn voxelizeSolid() void {
+    var out = Voxelizer.Grid{};
+    Voxelizer.voxelize(&models.torus, &meshTransform, .solid, &out);
+    std.mem.doNotOptimizeAway(out);
+}
+
+const generation = Rate{ .items = 1, .what = "generations" };
+const torusTriangles = Rate{ .items = models.torus.triangles.len, .what = "triangles" };
+pub const kernels = [_]Kernel{
+    .{ .name = "set_pixel x512", .run = &setPixelAll },
+    .{ .name = "clearFrame", .run = &clearFrame },
+    .{ .name = "FpRotor.rotateVector", .run = &rotateVector },
+    .{ .name = "imu.fuse", .run = &imuFuse },
+    .{ .name = "DrawList clear+box+sphere", .run = &drawListBoxes },
+    .{ .name = "Surface.over", .run = &compositorOver },
+    .{ .name = "dissolve frame", .run = &compositorDissolve },
+    .{ .name = "Orientation.remap", .run = &orientationRemap },
+    .{ .name = "Life generation", .run = &lifeGeneration, .rate = generation },
+    .{ .name = "Water generation", .run = &sandGeneration, .rate = generation },
+    .{ .name = "Voxelize torus surface", .run = &voxelizeSurface, .rate = torusTriangles },
+    .{ .name = "Voxelize torus solid", .run = &voxelizeSolid, .rate = torusTriangles },
+};
+
+test "every kernel runs off the cube" {
+    for (kernels) |kernel| {
+        kernel.run();
+    }
+    var expected = FrameBufferTypes.FrameBuffer{};
+    for (0..8) |x| {
+        for (0..8) |y| {
+            for (0..8) |z| {
+                expected.set_pixel(@intCast(x), @intCast(y), @intCast(z), color);
+            }
+        }
+    }
+    frame.clear(color);
+    try std.testing.expectEqualSlices(u8, std.mem.asBytes(&expected), std.mem.asBytes(&frame));
+}
@@ -1,6 +1,11 @@
 const std = @import("std");
 const cImports = @import("cImport.zig");
 const matrix = @import("subsystems/matrix.zig");
+const Color = @import("subsystems/color.zig");
+const DrawList = @import("subsystems/drawList.zig");
+const Orientation = @import("subsystems/orientation.zig");
+const imu = @import("subsystems/imu.zig");
+const Latency = @import("util/latency.zig");
 const deltaTime = @import("subsystems/deltaTime.zig");
 const joystick = @import("subsystems/joystick.zig");
 const button_a = @import("subsystems/button_a.zig");
@@ -15,6 +20,96 @@ pub export fn clearFrame(color: u16) void {
     matrix.clearFrame(@bitCast(@as(u3, @intCast(color))));
 }
 
+pub export fn setPixelRgb(x: i32, y: i32, z: i32, rgb: u32) void {
+    Color.setPixel(x, y, z, Color.Rgb.fromHex(rgb));
+}
+
+pub export fn clearFrameRgb(rgb: u32) void {
+    Color.clearFrame(Color.Rgb.fromHex(rgb));
+}
+
+pub export fn renderRgb() void {
+    Color.render();
+}
+
+pub export fn enableBAM() void {
+    matrix.enableBAM();
+}
+
+pub export fn disableBAM() void {
+    matrix.disableBAM();
+}
+
+fn led(color: u16) matrix.Led {
+    return @bitCast(@as(u3, @intCast(color)));
+}
+
+pub export fn drawVoxel(x: i32, y: i32, z: i32, color: u16) bool {
+    return DrawList.shared.voxel(x, y, z, led(color));
+}
+
+pub export fn drawSpan(x: i32, y: i32, z: i32, axis: u8, len: i32, color: u16) bool {
+    if (axis > @intFromEnum(DrawList.Axis.z)) {
+        return false;
+    }
+    return DrawList.shared.span(x, y, z, @enumFromInt(axis), len, led(color));
+}
+
+pub export fn drawBox(x0: i32, y0: i32, z0: i32, x1: i32, y1: i32, z1: i32, color: u16) bool {
+    return DrawList.shared.box(x0, y0, z0, x1, y1, z1, led(color));
+}
+
+pub export fn drawLine(x0: i32, y0: i32, z0: i32, x1: i32, y1: i32, z1: i32, color: u16) bool {
+    return DrawList.shared.line(x0, y0, z0, x1, y1, z1, led(color));
+}
+
+pub export fn drawSphere(x: i32, y: i32, z: i32, radius: i32, color: u16) bool {
+    return DrawList.shared.sphere(x, y, z, radius, led(color));
+}
+
+pub export fn drawBlit(z: i32, bits: u64, color: u16) bool {
+    return DrawList.shared.blit(z, bits, led(color));
+}
+
+pub export fn drawClear(color: u16) bool {
+    return DrawList.shared.clear(led(color));
+}
+
+pub export fn drawSubmit() void {
+    DrawList.shared.submit();
+}
+
+pub export fn setOrientation(index: u8) void {
+    if (index >= Orientation.count) {
+        return;
+    }
+    Orientation.set(@intCast(index));
+}
+
+pub export fn setAutoOrientation(on: bool) void {
+    Orientation.setAuto(on);
+}
+
+pub export fn updateAutoOrientation() void {
+    if (Orientation.isAuto()) {
+        Orientation.follow(imu.readGravity());
+    }
+}
+
+pub export fn setOrientationYaw(quarters: u8) void {
+    Orientation.setYaw(@truncate(quarters));
+}
+
+pub export fn getInputLatency(input: *Latency.Summary, display: *Latency.Summary, total: *Latency.Summary) void {
+    input.* = Latency.tracker.input.summary();
+    display.* = Latency.tracker.display.summary();
+    total.* = Latency.tracker.total.summary();
+}
+
+pub export fn resetInputLatency() void {
+    Latency.tracker.reset();
+}
+
 comptime {
     @export(matrix.render, .{ .name = "matrixRender", .linkage = .strong });
     @export(deltaTime.timestamp, .{ .name = "dtTimestamp", .linkage = .strong });
@@ -39,6 +39,9 @@ pub extern fn nano_wait(ns: c_uint) void;
 pub extern fn LCD_Setup() void;
 
 pub extern fn init_adc(outVecVar: *[2]u32) void;
+pub extern fn adc_begin() void;
+pub extern fn adc_try_enable() c_int;
+pub extern fn adc_finish(outVecVar: *[2]u32) void;
 pub extern fn init_button_a() void;
 pub extern fn init_button_b() void;
 pub extern fn init_debounce() void;
@@ -0,0 +1,19 @@
+/// hostTests.zig
+/// Root of `zig build test`. Only files that depend on nothing but std go in here,
+/// anything that pulls in microzig or the CMSIS headers won't build for the host.
+test {
+    _ = @import("util/trace.zig");
+    _ = @import("util/layerRing.zig");
+    _ = @import("util/latency.zig");
+    _ = @import("util/bamJitter.zig");
+    _ = @import("init/boot.zig");
+    _ = @import("subsystems/frameBuffer.zig");
+    _ = @import("subsystems/color.zig");
+    _ = @import("subsystems/drawList.zig");
+    _ = @import("subsystems/compositor.zig");
+    _ = @import("subsystems/orientation.zig");
+    _ = @import("subsystems/automaton.zig");
+    _ = @import("subsystems/voxelizer.zig");
+    _ = @import("replay.zig");
+    _ = @import("benchKernels.zig");
+}
@@ -0,0 +1,169 @@
+/// boot.zig
+/// Runs subsystem bring-up as a set of small state machines instead of one long blocking sequence.
+/// Each stage's step function does a short burst of work and says when it wants to run again,
+/// so the waits of one stage (LCD reset, ICM reset, HSI14 startup) overlap with the work of the others.
+/// The clock's idle() gets called once per pass over the stages, which the firmware uses for a boot animation.
+/// Only depends on std and takes its clock from the caller, so it runs just as well on simulated time.
+const std = @import("std");
+
+pub const Step = union(enum) {
+    /// Run again once this many ms have passed
+    wait_ms: u32,
+    /// Run again on the next pass. For polling ready flags
+    poll,
+    done,
+};
+
+pub const Stage = struct {
+    name: []const u8,
+    /// Does one step of the bring-up. phase starts at 0 and is the stage's to use as it likes
+    step: *const fn (phase: *u8) Step,
+    /// Index of a stage that has to be done before this one starts
+    after: ?usize = null,
+};
+
+/// The firmware's clock is TIM3's 16 bit counter (deltaTime.millis()), so now() wraps every 65536 ms
+pub const clock_mask: u32 = 0xFFFF;
+
+fn elapsed(from: u32, to: u32) u32 {
+    return (to -% from) & clock_mask;
+}
+
+/// All in ms since run() started, so they don't wrap unless boot takes over a minute
+pub const Timing = struct {
+    start_ms: u32 = 0,
+    end_ms: u32 = 0,
+    /// Time spent inside step(), as opposed to waiting
+    busy_ms: u32 = 0,
+
+    pub fn duration(self: Timing) u32 {
+        return self.end_ms - self.start_ms;
+    }
+};
+
+const State = enum { pending, running, done };
+
+/// Brings every stage up and returns how long each one took.
+/// clock needs now() -> u32 in ms (only the bits in clock_mask count), and idle(), which should return quickly
+pub fn run(comptime stages: []const Stage, clock: anytype) [stages.len]Timing {
+    const origin = clock.now();
+    var timings = [_]Timing{.{}} ** stages.len;
+    var phases = [_]u8{0} ** stages.len;
+    var wake = [_]u32{0} ** stages.len;
+    var states = [_]State{.pending} ** stages.len;
+    var remaining: usize = stages.len;
+
+    while (remaining > 0) {
+        inline for (stages, 0..) |stage, i| {
+            const blocked = if (stage.after) |dep| states[dep] != .done else false;
+            if (states[i] != .done and !blocked and elapsed(origin, clock.now()) >= wake[i]) {
+                const t0 = elapsed(origin, clock.now());
+                if (states[i] == .pending) {
+                    states[i] = .running;
+                    timings[i].start_ms = t0;
+                }
+                const step = stage.step(&phases[i]);
+                const t1 = elapsed(origin, clock.now());
+                timings[i].busy_ms += elapsed(t0, t1);
+                switch (step) {
+                    .wait_ms => |ms| wake[i] = t1 + ms,
+                    .poll => wake[i] = t1,
+                    .done => {
+                        states[i] = .done;
+                        timings[i].end_ms = t1;
+                        remaining -= 1;
+                    },
+                }
+            }
+        }
+        clock.idle();
+    }
+    return timings;
+}
+
+/// Start of the first stage to the end of the last one
+pub fn total(timings: []const Timing) u32 {
+    var first: u32 = std.math.maxInt(u32);
+    var last: u32 = 0;
+    for (timings) |t| {
+        first = @min(first, t.start_ms);
+        last = @max(last, t.end_ms);
+    }
+    return last -| first;
+}
+
+pub fn printReport(writer: anytype, comptime stages: []const Stage, timings: [stages.len]Timing) !void {
+    var sequential: u32 = 0;
+    inline for (stages, timings) |stage, t| {
+        try writer.print("Boot {s}: {} ms ({} ms busy)\n", .{ stage.name, t.duration(), t.busy_ms });
+        sequential += t.duration();
+    }
+    try writer.print("Boot total: {} ms, {} ms back to back\n", .{ total(&timings), sequential });
+}
+
+// Simulated bring-up. Same waits as the real LCD & IMU stages
+const Sim = struct {
+    const Clock = struct {
+        t: u32 = 0,
+
+        fn now(self: *Clock) u32 {
+            return self.t & clock_mask;
+        }
+
+        fn idle(self: *Clock) void {
+            self.t += 1;
+        }
+    };
+
+    fn lcd(phase: *u8) Step {
+        phase.* += 1;
+        return switch (phase.*) {
+            1 => .{ .wait_ms = 100 },
+            2 => .{ .wait_ms = 50 },
+            3 => .{ .wait_ms = 120 },
+            else => .done,
+        };
+    }
+
+    fn imu(phase: *u8) Step {
+        phase.* += 1;
+        return switch (phase.*) {
+            1 => .{ .wait_ms = 2 },
+            // Reset bit takes a few polls to clear
+            2, 3, 4 => .poll,
+            else => .done,
+        };
+    }
+
+    fn quick(_: *u8) Step {
+        return .done;
+    }
+
+    const stages = [_]Stage{
+        .{ .name = "lcd", .step = lcd },
+        .{ .name = "imu", .step = imu },
+        .{ .name = "inputs", .step = quick, .after = 1 },
+    };
+};
+
+test "stages overlap and respect dependencies" {
+    var clock = Sim.Clock{};
+    const timings = run(&Sim.stages, &clock);
+
+    // The LCD's waits dominate and everything else fits inside them
+    try std.testing.expect(timings[0].duration() >= 270 and timings[0].duration() <= 275);
+    try std.testing.expectEqual(timings[0].duration(), total(&timings));
+    // Dependencies are respected
+    try std.testing.expect(timings[2].start_ms >= timings[1].end_ms);
+    try std.testing.expect(timings[1].end_ms < timings[0].end_ms);
+}
+
+test "the clock wrapping mid boot changes nothing" {
+    var from_zero = Sim.Clock{};
+    const expected = run(&Sim.stages, &from_zero);
+    var wrapping = Sim.Clock{ .t = clock_mask - 100 };
+    const timings = run(&Sim.stages, &wrapping);
+    for (expected, timings) |e, t| {
+        try std.testing.expectEqual(e, t);
+    }
+}
@@ -0,0 +1,135 @@
+/// bringup.zig
+/// This board's boot stages for boot.zig, plus the animation the cube shows while they run.
+/// The cube has to be up before this (LedMatrix.init), and deltaTime too, since that's the clock.
+const std = @import("std");
+const buildMode = @import("builtin").mode;
+const cImport = @import("../cImport.zig");
+const lcd = cImport.cMenuDisp;
+const Boot = @import("boot.zig");
+const LedMatrix = @import("../subsystems/matrix.zig");
+const DrawList = @import("../subsystems/drawList.zig");
+const Screen = @import("../subsystems/screen.zig");
+const Joystick = @import("../subsystems/joystick.zig");
+const imu = @import("../subsystems/imu.zig");
+const deltaTime = @import("../subsystems/deltaTime.zig");
+const UartDebug = @import("../util/uartDebug.zig");
+
+/// LCD_Clear in chunks this many lines tall, so the other stages get a turn in between
+const clear_band = 16;
+const clear_bands = cImport.cMenuDisp.LCD_H / clear_band;
+
+fn lcdStep(phase: *u8) Boot.Step {
+    defer phase.* += 1;
+    switch (phase.*) {
+        0 => {
+            lcd.LCD_BeginReset();
+            return .{ .wait_ms = 100 };
+        },
+        1 => {
+            lcd.LCD_EndReset();
+            return .{ .wait_ms = 50 };
+        },
+        2 => {
+            lcd.LCD_SendInitSequence();
+            // Sleep out needs 120 ms
+            return .{ .wait_ms = 120 };
+        },
+        3 => {
+            lcd.LCD_FinishInit();
+            return .poll;
+        },
+        4...4 + clear_bands - 1 => {
+            const y = @as(u16, phase.* - 4) * clear_band;
+            lcd.LCD_DrawFillRectangle(0, y, lcd.LCD_W - 1, y + clear_band - 1, lcd.SCREEN_WHITE);
+            return .poll;
+        },
+        else => {
+            Screen.draw_menu();
+            return .done;
+        },
+    }
+}
+
+fn imuStep(phase: *u8) Boot.Step {
+    if (phase.* == 0) {
+        phase.* = 1;
+        imu.startInit();
+        // 2 ms startup time
+        return .{ .wait_ms = 2 };
+    }
+    return if (imu.pollReset()) .done else .poll;
+}
+
+fn adcStep(phase: *u8) Boot.Step {
+    if (phase.* == 0) {
+        phase.* = 1;
+        cImport.adc_begin();
+        return .poll;
+    }
+    if (cImport.adc_try_enable() == 0) {
+        return .poll;
+    }
+    cImport.adc_finish(&Joystick.voltVec);
+    return .done;
+}
+
+fn inputsStep(_: *u8) Boot.Step {
+    cImport.init_button_a();
+    cImport.init_button_b();
+    cImport.init_debounce();
+    return .done;
+}
+
+pub const stages = [_]Boot.Stage{
+    .{ .name = "lcd", .step = lcdStep },
+    .{ .name = "imu", .step = imuStep },
+    .{ .name = "adc", .step = adcStep },
+    // Debounce samples the joystick, so it goes after the adc like it always has
+    .{ .name = "inputs", .step = inputsStep, .after = 2 },
+};
+
+// -----------------
+// Boot animation
+// -----------------
+const frame_ms = 25;
+
+const Clock = struct {
+    lastFrame: u32 = 0,
+
+    pub fn now(_: *Clock) u32 {
+        return deltaTime.millis();
+    }
+
+    /// A plane sweeping up the cube and back down, changing colour every trip
+    pub fn idle(self: *Clock) void {
+        const t = self.now();
+        if (t -% self.lastFrame < frame_ms) {
+            return;
+        }
+        self.lastFrame = t;
+        const step = t / frame_ms;
+        const z: i32 = @intCast(if (step % 16 < 8) step % 8 else 7 - step % 8);
+        const colors = [_]LedMatrix.Led{
+            .{ .r = 0, .g = 0, .b = 1 },
+            .{ .r = 0, .g = 1, .b = 1 },
+            .{ .r = 1, .g = 0, .b = 1 },
+        };
+        const list = &DrawList.shared;
+        _ = list.clear(.{ .r = 0, .g = 0, .b = 0 });
+        _ = list.box(0, 0, z, 7, 7, z, colors[(step / 16) % colors.len]);
+        list.submit();
+    }
+};
+
+/// Brings up everything after the cube, animating it meanwhile. Prints stage times in debug builds
+pub fn run() void {
+    var clock = Clock{ .lastFrame = deltaTime.millis() };
+    const timings = Boot.run(&stages, &clock);
+
+    LedMatrix.clearFrame(.{ .r = 0, .g = 0, .b = 0 });
+    LedMatrix.render();
+
+    if (buildMode == .Debug) {
+        Boot.printReport(UartDebug.writer, &stages, timings) catch {};
+    }
+}
@@ -0,0 +1,47 @@
+/// interrupts.zig
+/// NVIC priority plan. The M0 only has 4 levels (0 is the most urgent), and every interrupt gets its own,
+/// so a more urgent one always preempts a less urgent one that's already running.
+///     bam: TIM15, BAM plane timing. A late plane is a plane shown too long, which is wrong brightness and flicker
+///     dma: layer streaming refills, which have a whole layer time to finish.
+///         Otherwise only on for one scan after a frame that carries input, to stamp it for latency.zig
+///     sampling: TIM14. Only reads the inputs and pends PendSV
+///     deferred: PendSV. Debouncing, and anything else that can wait until everything above is done
+/// Anything new (I2C, uart, ...) should go in at sampling or below, and push its real work to PendSV.
+const cmsis = @import("../cImport.zig").cmsis;
+const Debounce = @import("../subsystems/debounce.zig");
+
+pub const Priority = enum(u2) { bam, dma, sampling, deferred };
+
+/// Priorities live in the top bits of each byte
+const priority_shift: u5 = 8 - cmsis.__NVIC_PRIO_BITS;
+
+/// The priority registers can only be written a word at a time on the M0, 4 interrupts to a word
+fn setIrqPriority(irq: c_int, priority: Priority) void {
+    const n: u32 = @intCast(irq);
+    const shift: u5 = @intCast((n % 4) * 8);
+    const reg = &cmsis.NVIC.*.IP[n / 4];
+    reg.* = (reg.* & ~(@as(u32, 0xFF) << shift)) | (@as(u32, @intFromEnum(priority)) << priority_shift << shift);
+}
+
+/// PendSV is a system exception, so it's in SCB->SHPR3 (SHP[1]) bits 16-23 instead
+fn setPendSvPriority(priority: Priority) void {
+    const reg = &cmsis.SCB.*.SHP[1];
+    reg.* = (reg.* & ~(@as(u32, 0xFF) << 16)) | (@as(u32, @intFromEnum(priority)) << priority_shift << 16);
+}
+
+/// Call before anything enables its interrupt
+pub fn init() void {
+    setIrqPriority(cmsis.TIM15_IRQn, .bam);
+    setIrqPriority(cmsis.DMA1_Ch4_7_DMA2_Ch3_5_IRQn, .dma);
+    setIrqPriority(cmsis.TIM14_IRQn, .sampling);
+    setPendSvPriority(.deferred);
+}
+
+/// Runs PendSV_Handler once every interrupt above it has finished
+pub inline fn pendDeferred() void {
+    cmsis.SCB.*.ICSR = cmsis.SCB_ICSR_PENDSVSET_Msk;
+}
+
+pub export fn PendSV_Handler() callconv(.C) void {
+    Debounce.process();
+}
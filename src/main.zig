@@ -17,6 +17,12 @@ const UartDebug = @import("util/uartDebug.zig");
 const zigApps = @import("apps/index.zig").zigApps;
 const buildMode = @import("builtin").mode;
 const ChipInit = @import("init/general.zig");
+const Interrupts = @import("init/interrupts.zig");
+const Bringup = @import("init/bringup.zig");
+const Trace = @import("util/trace.zig");
+const Compositor = @import("subsystems/compositor.zig");
+const Latency = @import("util/latency.zig");
+const Orientation = @import("subsystems/orientation.zig");
 
 // Make sure everything gets exported
 comptime {
@@ -29,6 +35,7 @@ pub const microzig_options = .{
         .DMA1_Ch4_7_DMA2_Ch3_5 = microzig.interrupt.Handler{ .C = LedMatrix.IRQ_DMA1_Ch4_7_DMA2_Ch3_5 },
         .TIM14 = microzig.interrupt.Handler{ .C = Debounce.TIM14_IRQHandler },
         .TIM15 = microzig.interrupt.Handler{ .C = LedMatrix.TIM15_IRQ },
+        .PendSV = microzig.interrupt.Handler{ .C = Interrupts.PendSV_Handler },
     },
 };
 
@@ -39,21 +46,18 @@ pub const apps = zigApps ++ cImport.cApps;
 
 pub fn main() void {
     ChipInit.internal_clock();
-    LedMatrix.init(.Div4);
+    Interrupts.init();
+    LedMatrix.init(&LedMatrix.profiles.bam8_80hz);
     deltaTime.init();
 
     if (buildMode == .Debug) {
         UartDebug.init();
+        LedMatrix.printBudgetTable(UartDebug.writer, 80) catch {};
     }
 
-    // initializing display
+    // LCD, IMU, joystick & buttons come up together while the cube shows a boot animation
     const MENU = "Select App:";
-    Screen.screen_init();
-    Joystick.joystick_init();
-    cImport.init_button_a();
-    cImport.init_button_b();
-    cImport.init_debounce();
-    imu.init();
+    Bringup.run();
 
     UartDebug.printIfDebug("All subsystems initialized!\n", .{}) catch {};
 
@@ -69,10 +73,38 @@ pub fn main() void {
             if (Joystick.button_pressed()) {
                 cImport.cMenuDisp.jump_to_app(@ptrCast(apps[@intCast(APP_NUM)]));
                 const appMain = apps[@intCast(APP_NUM)].renderFn.?;
+                // Hold A while launching to record the session, or B to replay the last recording.
+                // cur() stays set until the app polls an edge, so check the debounced level instead
+                const traceMode: Trace.Mode = if (Button_A.memory_byte_full()) .record else if (Button_B.memory_byte_full()) .replay else .off;
+                switch (traceMode) {
+                    .record => Trace.startRecording(@intCast(APP_NUM), std.mem.span(apps[@intCast(APP_NUM)].name)),
+                    .replay => Trace.startReplay(Trace.recorded(), @intCast(APP_NUM)) catch {},
+                    .off => {},
+                }
                 appMain();
+                const traceStats = Trace.stop();
+                // Whatever way up the app left the cube, the menu and the next app start upright
+                Orientation.setAuto(false);
+                Orientation.setYaw(0);
+                Orientation.set(0);
+                if (buildMode == .Debug) {
+                    if (traceMode != .off) {
+                        Trace.printSummary(UartDebug.writer) catch {};
+                    }
+                    if (traceMode == .record) {
+                        Trace.dump(UartDebug.writer) catch {};
+                    }
+                    Latency.tracker.printReport(UartDebug.writer) catch {};
+                }
                 cImport.cMenuDisp.reload_menu(MENU, @ptrCast(&apps));
-                LedMatrix.clearFrame(Draw.Color(.BLACK));
-                LedMatrix.render();
+                // Dissolve whatever the app left on the cube instead of cutting to black,
+                // or to red if the recording ran out of space and only has the start of the session
+                const lastFrame = Compositor.Surface.fromFrame(LedMatrix.getShownBuffer());
+                var exitTo = Compositor.Surface{};
+                if (traceMode == .record and traceStats.overflowed) {
+                    exitTo.clear(.{ .r = 1, .g = 0, .b = 0 });
+                }
+                Compositor.playTransition(&lastFrame, &exitTo, .dissolve, 300);
                 continue;
             }
             if (Joystick.moved_up()) {
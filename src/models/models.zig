@@ -0,0 +1,10 @@
+/// models.zig
+/// Meshes for the voxelizer. OBJ files in this folder get embedded and parsed at compile time,
+/// so adding a model is dropping the file in and adding a line here. Keep them under Voxelizer.max_vertices.
+const Voxelizer = @import("../subsystems/voxelizer.zig");
+
+pub const icosahedron = Voxelizer.parseObj(@embedFile("icosahedron.obj"), 6);
+/// 256 triangles, what the voxelizer benchmark runs on
+pub const torus = Voxelizer.torus(2.4, 1.1, 16, 8);
+
+pub const all = [_]*const Voxelizer.Mesh{ &icosahedron, &torus };
@@ -0,0 +1,51 @@
+/// replay.zig
+/// Replays traces recorded on the cube (see util/trace.zig) on Linux, against the same app logic,
+/// so a real session becomes a repeatable benchmark and golden-frame test. Only depends on std.
+/// Root of the replay runner's module (tools/replayTrace.zig, zig build replay).
+/// Only Life & Sand runs off the cube so far, traces from any other app get refused with error.NotReplayable.
+const std = @import("std");
+pub const Trace = @import("util/trace.zig");
+pub const TraceIo = @import("apps/logic/traceIo.zig").TraceIo;
+const LifeSand = @import("apps/logic/lifeSand.zig");
+
+/// Plays data back through the app and says how it went. data has to stay put until this returns
+pub fn replay(data: []const u8) !Trace.Stats {
+    const reader = try Trace.Reader.init(data);
+    if (!std.mem.eql(u8, reader.name, LifeSand.name)) {
+        return error.NotReplayable;
+    }
+    // The app's index in the menu depends on the build, so take the trace's word for it
+    try Trace.startReplay(data, reader.app);
+    var io = TraceIo{};
+    LifeSand.run(&io);
+    return Trace.stop();
+}
+
+test "a recorded session replays frame for frame" {
+    // Life, then sand, then water, lying on its side
+    var recording = TraceIo{ .script = .{ .seed = 7, .step_ms = 50, .gravity = .{ 0, 16384, 0 }, .right = &.{ 40, 120 }, .exit = 300 } };
+    Trace.startRecording(0, LifeSand.name);
+    LifeSand.run(&recording);
+    try std.testing.expect(!Trace.stop().overflowed);
+    try std.testing.expect(recording.frames > 100);
+
+    // Copied out, the trace buffer isn't the test's to keep
+    var trace: [Trace.capacity]u8 = undefined;
+    const data = trace[0..Trace.recorded().len];
+    @memcpy(data, Trace.recorded());
+
+    try std.testing.expectEqual(Trace.Stats{ .frames = recording.frames, .frameMismatches = 0, .desynced = false, .overflowed = false }, try replay(data));
+
+    // One wrong frame CRC is one mismatch, and everything after it still lines up
+    var r = try Trace.Reader.init(data);
+    while ((try r.next()) != .frame) {}
+    data[r.pos - 1] ^= 1;
+    const tampered = try replay(data);
+    try std.testing.expectEqual(@as(u32, 1), tampered.frameMismatches);
+    try std.testing.expect(!tampered.desynced);
+
+    // Any other app's trace would only desync
+    Trace.startRecording(0, "3D Snake");
+    _ = Trace.stop();
+    try std.testing.expectError(error.NotReplayable, replay(Trace.recorded()));
+}
@@ -0,0 +1,417 @@
+/// automaton.zig
+/// Cellular automata on bitboards. The grid is a compositor Mask (a u64 per layer, a bit per voxel),
+/// so a whole generation is a few hundred word ops instead of 512 trips through set_pixel.
+/// Life counts all 26 neighbours at once with bit-sliced adders: along each row, then across rows,
+/// then across layers, ending with a 5 bit count per voxel spread over 5 words.
+/// Sand (and water) moves grains one voxel per generation along a gravity direction,
+/// which can follow the IMU. Moves only ever go into empty voxels, so grains are never made or lost.
+/// Nothing wraps around: the cube's edges are walls.
+/// Only depends on std, so it runs under zig build test.
+const std = @import("std");
+const FrameBufferTypes = @import("frameBuffer.zig");
+const Compositor = @import("compositor.zig");
+const Orientation = @import("orientation.zig");
+const FrameBuffer = FrameBufferTypes.FrameBuffer;
+const Led = FrameBufferTypes.Led;
+
+pub const Grid = Compositor.Mask;
+
+const all_ones: u64 = std.math.maxInt(u64);
+/// Voxel 0 (y = 7) and voxel 7 (y = 0) of every row
+const first_voxels: u64 = 0x0101_0101_0101_0101;
+const last_voxels: u64 = 0x8080_8080_8080_8080;
+
+pub const Dir = enum(u3) {
+    pos_x,
+    neg_x,
+    pos_y,
+    neg_y,
+    pos_z,
+    neg_z,
+
+    pub fn opposite(self: Dir) Dir {
+        return @enumFromInt(@intFromEnum(self) ^ 1);
+    }
+
+    /// 0 for x, 1 for y, 2 for z
+    pub fn axis(self: Dir) u2 {
+        return @intCast(@intFromEnum(self) / 2);
+    }
+
+    pub fn negative(self: Dir) bool {
+        return @intFromEnum(self) & 1 == 1;
+    }
+};
+
+/// Moves every voxel of a layer one step within the layer. What goes over the edge is gone
+fn shiftLayer(l: u64, dir: Dir) u64 {
+    return switch (dir) {
+        // Row r holds x = 7 - r
+        .pos_x => l >> 8,
+        .neg_x => l << 8,
+        // Voxel i holds y = 7 - i, and must not spill into the next row
+        .pos_y => (l >> 1) & ~last_voxels,
+        .neg_y => (l << 1) & ~first_voxels,
+        .pos_z, .neg_z => l,
+    };
+}
+
+/// Moves every voxel one step in dir. What goes over the edge is gone, and the far side comes in empty
+pub fn shift(g: Grid, dir: Dir) Grid {
+    var out = Grid{};
+    switch (dir) {
+        .pos_z => {
+            for (1..8) |z| {
+                out.layers[z] = g.layers[z - 1];
+            }
+        },
+        .neg_z => {
+            for (0..7) |z| {
+                out.layers[z] = g.layers[z + 1];
+            }
+        },
+        else => {
+            for (&out.layers, g.layers) |*o, l| {
+                o.* = shiftLayer(l, dir);
+            }
+        },
+    }
+    return out;
+}
+
+// -----
+// Life
+// -----
+
+/// Bit n of a set stands for n live neighbours, 0..26
+pub const Rule = struct {
+    /// Dead voxels with a neighbour count in here come alive
+    birth: u32,
+    /// Live voxels with a neighbour count in here stay alive
+    survive: u32,
+
+    pub fn init(comptime birth: []const u5, comptime survive: []const u5) Rule {
+        return .{ .birth = countSet(birth), .survive = countSet(survive) };
+    }
+
+    /// lo..hi inclusive
+    pub fn range(lo: u5, hi: u5) u32 {
+        return (@as(u32, std.math.maxInt(u32)) >> @intCast(31 - @as(u32, hi))) & ~((@as(u32, 1) << lo) - 1);
+    }
+
+    fn countSet(comptime counts: []const u5) u32 {
+        var out: u32 = 0;
+        for (counts) |n| {
+            out |= @as(u32, 1) << n;
+        }
+        return out;
+    }
+};
+
+pub const rules = struct {
+    /// Bays' Life 4555. Has gliders, blinkers and still lifes like the 2D game
+    pub const life4555 = Rule.init(&.{5}, &.{ 4, 5 });
+    /// Bays' Life 5766. Quieter, things die off or freeze sooner
+    pub const life5766 = Rule.init(&.{6}, &.{ 5, 6, 7 });
+    /// Random noise clumps into slowly shrinking blobs
+    pub const clouds = Rule{ .birth = Rule.range(13, 26), .survive = Rule.range(13, 26) };
+};
+
+/// a + b, bit-sliced: word k holds bit k of every voxel's number
+fn add(comptime n: usize, a: [n]u64, b: [n]u64) [n + 1]u64 {
+    var out: [n + 1]u64 = undefined;
+    var carry: u64 = 0;
+    for (0..n) |k| {
+        const half = a[k] ^ b[k];
+        out[k] = half ^ carry;
+        carry = (a[k] & b[k]) | (carry & half);
+    }
+    out[n] = carry;
+    return out;
+}
+
+/// Live voxels in each voxel's 3x3 square of its layer, itself included (0..9)
+fn planeCount(l: u64) [4]u64 {
+    // 3 in a row, a full adder gives 0..3
+    const left = shiftLayer(l, .pos_y);
+    const right = shiftLayer(l, .neg_y);
+    const half = l ^ left;
+    const row = [2]u64{ half ^ right, (l & left) | (right & half) };
+    // Plus the rows on either side
+    var up: [2]u64 = undefined;
+    var down: [2]u64 = undefined;
+    for (row, &up, &down) |word, *u, *d| {
+        u.* = shiftLayer(word, .pos_x);
+        d.* = shiftLayer(word, .neg_x);
+    }
+    return add(3, add(2, row, up), .{ down[0], down[1], 0 });
+}
+
+/// Voxels whose count is exactly n
+fn equals(count: [5]u64, n: u5) u64 {
+    var out = all_ones;
+    for (count, 0..) |word, k| {
+        out &= if ((n >> @intCast(k)) & 1 == 1) word else ~word;
+    }
+    return out;
+}
+
+/// Voxels whose count is in the set
+fn inSet(count: [5]u64, set: u32) u64 {
+    var out: u64 = 0;
+    var rest = set;
+    while (rest != 0) : (rest &= rest - 1) {
+        out |= equals(count, @intCast(@ctz(rest)));
+    }
+    return out;
+}
+
+pub fn lifeStep(g: *const Grid, rule: Rule) Grid {
+    var planes: [8][4]u64 = undefined;
+    for (&planes, g.layers) |*p, l| {
+        p.* = planeCount(l);
+    }
+    const empty = [4]u64{ 0, 0, 0, 0 };
+    var out = Grid{};
+    for (&out.layers, g.layers, 0..) |*o, self, z| {
+        const below = if (z > 0) planes[z - 1] else empty;
+        const above = if (z < 7) planes[z + 1] else empty;
+        // 3x3x3 total including the voxel itself, 0..27, so the 6th bit is always 0
+        const total = add(5, add(4, planes[z], below), .{ above[0], above[1], above[2], above[3], 0 });
+        const count = total[0..5].*;
+        // A live voxel counted itself, hence survive shifted up by one
+        o.* = (~self & inSet(count, rule.birth)) | (self & inSet(count, rule.survive << 1));
+    }
+    return out;
+}
+
+// -----
+// Sand
+// -----
+
+pub const Material = enum {
+    /// Falls, or slides down a diagonal. Settles into 45 degree piles
+    sand,
+    /// Like sand, but also spreads sideways when it can't go down
+    water,
+};
+
+/// The 4 directions across down, as quarter turns about it
+fn sideways(down: Dir) [4]Dir {
+    return switch (down.axis()) {
+        0 => .{ .pos_y, .pos_z, .neg_y, .neg_z },
+        1 => .{ .pos_z, .pos_x, .neg_z, .neg_x },
+        else => .{ .pos_x, .pos_y, .neg_x, .neg_y },
+    };
+}
+
+/// Moves every grain whose voxel one step along a (then b, if given) is empty, and is allowed to move.
+/// Each target has exactly one possible source, so nothing collides
+fn moveInto(g: Grid, allowed: Grid, a: Dir, b: ?Dir) Grid {
+    // targetEmpty[p] = empty[p + a + b]
+    var targetEmpty = shift(g.invert(), a.opposite());
+    if (b) |side| {
+        targetEmpty = shift(targetEmpty, side.opposite());
+    }
+    const moving = g.intersect(allowed).intersect(targetEmpty);
+    var moved = shift(moving, a);
+    if (b) |side| {
+        moved = shift(moved, side);
+    }
+    return g.intersect(moving.invert()).unite(moved);
+}
+
+/// One generation of falling grains. gen rotates which sideways direction goes first, so piles stay symmetric
+pub fn sandStep(g: *const Grid, down: Dir, material: Material, gen: u32) Grid {
+    var out = moveInto(g.*, Grid.all, down, null);
+    const sides = sideways(down);
+    for (0..4) |i| {
+        out = moveInto(out, Grid.all, down, sides[(i + gen) % 4]);
+    }
+    if (material == .water) {
+        for (0..4) |i| {
+            // Only grains sitting on something spread out
+            const resting = shift(out.invert(), down.opposite()).invert();
+            out = moveInto(out, resting, sides[(i + gen) % 4], null);
+        }
+    }
+    return out;
+}
+
+/// Below this (in g) no axis is trusted to be down, like when the cube is being thrown around
+const gravity_threshold = 0.3;
+
+/// Where gravity pulls, from raw accelerometer counts (imu.readGravity). null if there's no clear direction
+pub fn downFrom(accel: [3]i16) ?Dir {
+    const threshold: u32 = @intFromFloat(gravity_threshold * 16384.0);
+    const cube = Orientation.toCube(accel);
+    var best: usize = 0;
+    for (1..3) |d| {
+        if (@abs(cube[d]) > @abs(cube[best])) {
+            best = d;
+        }
+    }
+    if (@abs(cube[best]) < threshold) {
+        return null;
+    }
+    // A resting accelerometer reads +1 g pointing up
+    return @enumFromInt(best * 2 + @intFromBool(cube[best] > 0));
+}
+
+// ----------
+// Rendering
+// ----------
+
+/// Draws the grid's voxels in color straight into the packed rows, leaving the rest of the frame alone
+pub fn paint(frame: *FrameBuffer, g: *const Grid, color: Led) void {
+    const pattern = FrameBufferTypes.rowPattern(color);
+    for (&frame.layers, g.layers) |*data, l| {
+        for (0..8) |r| {
+            const byte: u8 = @truncate(l >> @intCast(8 * r));
+            data.writeRow(@intCast(r), Compositor.expandLut[byte], pattern);
+        }
+    }
+}
+
+const Check = struct {
+    fn fromList(voxels: []const [3]i32) Grid {
+        var g = Grid{};
+        for (voxels) |v| {
+            g.set(v[0], v[1], v[2], true);
+        }
+        return g;
+    }
+
+    fn random(seed: u32) Grid {
+        // xorshift32, ANDed down to about a quarter full
+        var state = seed;
+        var g = Grid{};
+        for (&g.layers) |*l| {
+            var words: [4]u32 = undefined;
+            for (&words) |*w| {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                w.* = state;
+            }
+            l.* = (@as(u64, words[0] & words[1]) << 32) | (words[2] & words[3]);
+        }
+        return g;
+    }
+
+    /// Life the slow way, one voxel and 26 neighbours at a time
+    fn naiveLife(g: *const Grid, rule: Rule) Grid {
+        var out = Grid{};
+        const offsets = [3]i32{ -1, 0, 1 };
+        for (0..8) |xu| {
+            for (0..8) |yu| {
+                for (0..8) |zu| {
+                    const x: i32 = @intCast(xu);
+                    const y: i32 = @intCast(yu);
+                    const z: i32 = @intCast(zu);
+                    var n: u5 = 0;
+                    for (offsets) |dx| {
+                        for (offsets) |dy| {
+                            for (offsets) |dz| {
+                                if (dx == 0 and dy == 0 and dz == 0) continue;
+                                const nx = x + dx;
+                                const ny = y + dy;
+                                const nz = z + dz;
+                                if (nx < 0 or ny < 0 or nz < 0 or nx > 7 or ny > 7 or nz > 7) continue;
+                                if (g.get(nx, ny, nz)) n += 1;
+                            }
+                        }
+                    }
+                    const set = if (g.get(x, y, z)) rule.survive else rule.birth;
+                    out.set(x, y, z, (set >> n) & 1 == 1);
+                }
+            }
+        }
+        return out;
+    }
+
+    fn eql(a: Grid, b: Grid) bool {
+        return std.mem.eql(u64, &a.layers, &b.layers);
+    }
+};
+
+test "rule ranges" {
+    try std.testing.expect(Rule.range(13, 26) == 0x07FF_E000);
+    try std.testing.expect(Rule.range(0, 0) == 1);
+}
+
+test "bit-sliced counting agrees with counting by hand, edges included" {
+    for ([_]Rule{ rules.life4555, rules.life5766, rules.clouds }, 0..) |rule, i| {
+        const g = Check.random(0x9E37_79B9 + @as(u32, @intCast(i)));
+        try std.testing.expect(Check.eql(lifeStep(&g, rule), Check.naiveLife(&g, rule)));
+    }
+}
+
+test "life 4555 still life and blinker" {
+    // Life 4555: a 6 voxel still life, and a 7 voxel blinker with period 2
+    const still = Check.fromList(&.{ .{ 2, 2, 3 }, .{ 2, 3, 3 }, .{ 3, 2, 3 }, .{ 2, 2, 4 }, .{ 2, 3, 4 }, .{ 3, 2, 4 } });
+    try std.testing.expect(Check.eql(lifeStep(&still, rules.life4555), still));
+    const core = [_][3]i32{ .{ 3, 4, 2 }, .{ 2, 4, 3 }, .{ 3, 3, 3 }, .{ 3, 5, 3 }, .{ 4, 4, 3 } };
+    const phaseA = Check.fromList(&(core ++ [_][3]i32{ .{ 3, 3, 4 }, .{ 3, 5, 4 } }));
+    const phaseB = Check.fromList(&(core ++ [_][3]i32{ .{ 2, 4, 4 }, .{ 4, 4, 4 } }));
+    try std.testing.expect(Check.eql(lifeStep(&phaseA, rules.life4555), phaseB));
+    try std.testing.expect(Check.eql(lifeStep(&phaseB, rules.life4555), phaseA));
+}
+
+test "shifts" {
+    // Shifts agree with the coordinates they claim to move along
+    var one = Grid{};
+    one.set(3, 5, 6, true);
+    try std.testing.expect(shift(one, .pos_x).get(4, 5, 6));
+    try std.testing.expect(shift(one, .neg_y).get(3, 4, 6));
+    try std.testing.expect(shift(one, .neg_z).get(3, 5, 5));
+    var edge = Grid{};
+    edge.set(2, 0, 0, true);
+    try std.testing.expect(shift(edge, .neg_y).count() == 0);
+    try std.testing.expect(shift(edge, .neg_z).count() == 0);
+}
+
+test "sand and water" {
+    // Sand and water keep every grain, whichever way is down, and sand comes to rest
+    for (0..6) |d| {
+        const down: Dir = @enumFromInt(d);
+        for ([_]Material{ .sand, .water }) |material| {
+            var g = Check.random(0x1234_5678 + @as(u32, @intCast(d)));
+            const grains = g.count();
+            for (0..32) |gen| {
+                g = sandStep(&g, down, material, @intCast(gen));
+                try std.testing.expect(g.count() == grains);
+            }
+            if (material == .sand) {
+                try std.testing.expect(Check.eql(sandStep(&g, down, .sand, 32), g));
+            }
+        }
+    }
+
+    // A dropped grain lands on the floor under where it started
+    var drop = Grid{};
+    drop.set(1, 6, 7, true);
+    for (0..7) |gen| {
+        drop = sandStep(&drop, .neg_z, .sand, @intCast(gen));
+    }
+    try std.testing.expect(drop.get(1, 6, 0));
+}
+
+test "down from the accelerometer" {
+    // The accelerometer reads up, so down is the other way
+    try std.testing.expect(downFrom(.{ 0, 0, 16384 }) == .neg_z);
+    try std.testing.expect(downFrom(.{ -12000, 3000, 2000 }) == .pos_x);
+    try std.testing.expect(downFrom(.{ 100, -200, 300 }) == null);
+}
+
+test "paint only touches the grid's voxels" {
+    var frame = FrameBuffer{};
+    frame.set_pixel(0, 0, 0, .{ .r = 1, .g = 0, .b = 0 });
+    var g = Grid{};
+    g.set(4, 2, 5, true);
+    paint(&frame, &g, .{ .r = 0, .g = 1, .b = 1 });
+    var expected = FrameBuffer{};
+    expected.set_pixel(0, 0, 0, .{ .r = 1, .g = 0, .b = 0 });
+    expected.set_pixel(4, 2, 5, .{ .r = 0, .g = 1, .b = 1 });
+    try std.testing.expect(std.mem.eql(u8, std.mem.asBytes(&frame), std.mem.asBytes(&expected)));
+}
@@ -3,6 +3,9 @@ const std = @import("std");
 const cImport = @import("../cImport.zig");
 const apps = @import("../main.zig").apps;
 const print = @import("../util/uartDebug.zig").printIfDebug;
+const Trace = @import("../util/trace.zig");
+const Latency = @import("../util/latency.zig");
+const deltaTime = @import("deltaTime.zig");
 
 var prev_pressed = false;
 var cur_pressed = false;
@@ -17,7 +20,8 @@ pub fn pressed() callconv(.C) bool {
     }
     prev_pressed = cur_pressed;
 
-    return (dummy_cur and !dummy_prev);
+    const edge = Trace.input(.button_b, dummy_cur and !dummy_prev);
+    return Latency.tracker.consume(.button_b, edge, deltaTime.millis());
 }
 
 pub fn memory_byte_full() bool {
@@ -0,0 +1,157 @@
+/// color.zig
+/// 24-bit colour front end for the BAM driver in matrix.zig.
+/// Apps hand us 8 bits per channel. A comptime gamma table maps each channel to a BAM level plus
+/// frac_bits of fraction, and a per-voxel residue carries that fraction from frame to frame
+/// (first order error diffusion in time). Averaged over a few frames the cube shows levels
+/// in between the ones the active scan profile's bit-planes can represent on their own.
+/// NOTE: matrix.enableBAM() must be called before render(), same as matrix.renderBAM()
+/// dither() and render() are the only parts that need matrix.zig, the gamma tables and the dither itself run on the host.
+const std = @import("std");
+const math = std.math;
+const matrix = @import("matrix.zig");
+const FrameBufferTypes = @import("frameBuffer.zig");
+
+pub const gamma: comptime_float = 2.2;
+/// Sub-level precision that gets dithered over time
+pub const frac_bits = 8;
+
+const BamInt = FrameBufferTypes.BAM_int;
+/// A BAM level in the upper bits, frac_bits of fraction in the lower ones
+const Level = std.meta.Int(.unsigned, FrameBufferTypes.BAM_bits + frac_bits);
+const Frac = std.meta.Int(.unsigned, frac_bits);
+const LevelShift = std.math.Log2Int(Level);
+
+pub const Rgb = struct {
+    r: u8 = 0,
+    g: u8 = 0,
+    b: u8 = 0,
+
+    /// Unpacks the 0xRRGGBB form that C apps use
+    pub fn fromHex(hex: u32) Rgb {
+        return .{
+            .r = @truncate(hex >> 16),
+            .g = @truncate(hex >> 8),
+            .b = @truncate(hex),
+        };
+    }
+};
+
+/// One gamma table per plane count a scan profile can have (index planes - 1).
+/// Maps an 8 bit perceptual value to a linear level out of (1 << planes) - 1, with frac_bits of fraction.
+/// Dithering at the depth that's actually shown means profiles with fewer planes don't just lose the low bits.
+pub const gammaLuts: [FrameBufferTypes.BAM_bits][256]Level = genLuts: {
+    @setEvalBranchQuota(1_000_000);
+    var luts: [FrameBufferTypes.BAM_bits][256]Level = undefined;
+    for (0..FrameBufferTypes.BAM_bits) |p| {
+        const full_scale: comptime_float = ((1 << (p + 1)) - 1) << frac_bits;
+        for (0..256) |i| {
+            const linear = math.pow(f64, @as(f64, @floatFromInt(i)) / 255.0, gamma);
+            luts[p][i] = @intFromFloat(@round(linear * full_scale));
+        }
+    }
+    break :genLuts luts;
+};
+
+// Colours the app asked for, and the fraction each channel has not been able to show yet
+var target: [8][8][8]Rgb = .{.{.{Rgb{}} ** 8} ** 8} ** 8;
+var residue: [8][8][8][3]Frac = undefined;
+var residueSeeded = false;
+
+/// Runs one channel through the gamma table and the temporal dither.
+/// Returns the level to emit this frame and updates the residue in place.
+/// shift moves the level up to the planes the active profile shows.
+inline fn ditherChannel(lut: *const [256]Level, value: u8, res: *Frac, shift: LevelShift) BamInt {
+    // Can't go past the top level: the table ends on a whole level, so the fraction is 0 there
+    const sum: Level = lut[value] + res.*;
+    res.* = @truncate(sum);
+    return @intCast((sum >> frac_bits) << shift);
+}
+
+/// Starts every voxel at a different point of the dither cycle so flat colours don't
+/// flip between levels in lockstep across the whole cube.
+pub fn resetDither() void {
+    // 2x2x2 ordered dither pattern
+    const bayer = [8]Frac{ 0, 4, 6, 2, 3, 7, 5, 1 };
+    for (0..8) |x| {
+        for (0..8) |y| {
+            for (0..8) |z| {
+                const ind = (x & 1) | ((y & 1) << 1) | ((z & 1) << 2);
+                const start: Frac = bayer[ind] << (frac_bits - 3);
+                residue[x][y][z] = .{ start, start, start };
+            }
+        }
+    }
+    residueSeeded = true;
+}
+
+pub fn setPixel(x: i32, y: i32, z: i32, color: Rgb) void {
+    target[@intCast(x)][@intCast(y)][@intCast(z)] = color;
+}
+
+pub fn clearFrame(color: Rgb) void {
+    for (&target) |*plane| {
+        for (plane) |*column| {
+            @memset(column, color);
+        }
+    }
+}
+
+/// Dithers the current targets into the BAM draw buffer and queues it for display.
+/// Call this at a steady rate even if the scene is static. The dither only advances
+/// when a frame is rendered.
+pub fn render() void {
+    dither();
+    matrix.renderBAM();
+}
+
+/// The per-frame part of render(): advances the dither and writes the BAM draw buffer, without showing it
+pub fn dither() void {
+    if (!residueSeeded) {
+        resetDither();
+    }
+    const planes = matrix.getProfile().planes;
+    const lut = &gammaLuts[planes - 1];
+    const shift: LevelShift = @intCast(FrameBufferTypes.BAM_bits - planes);
+    for (0..8) |x| {
+        for (0..8) |y| {
+            for (0..8) |z| {
+                const color = target[x][y][z];
+                const res = &residue[x][y][z];
+                matrix.setPixelBAM(@intCast(x), @intCast(y), @intCast(z), .{
+                    .r = ditherChannel(lut, color.r, &res[0], shift),
+                    .g = ditherChannel(lut, color.g, &res[1], shift),
+                    .b = ditherChannel(lut, color.b, &res[2], shift),
+                });
+            }
+        }
+    }
+}
+
+test "gamma tables run from off to full and never go down" {
+    inline for (gammaLuts, 1..) |lut, planes| {
+        try std.testing.expectEqual(@as(Level, 0), lut[0]);
+        try std.testing.expectEqual(@as(Level, ((1 << planes) - 1) << frac_bits), lut[255]);
+        for (1..256) |i| {
+            try std.testing.expect(lut[i] >= lut[i - 1]);
+        }
+    }
+}
+
+test "average emitted level lands on the gamma target" {
+    inline for (gammaLuts, 1..) |lut, planes| {
+        const shift: LevelShift = FrameBufferTypes.BAM_bits - planes;
+        // After n frames: sum(levels) << frac_bits == n * lut + res_start - res_end, so it is
+        // always within one level, and exact once n is a whole cycle from a zero residue.
+        const n = 1 << frac_bits;
+        var value: usize = 0;
+        while (value < 256) : (value += 15) {
+            var res: Frac = 0;
+            var sum: usize = 0;
+            for (0..n) |_| {
+                sum += ditherChannel(&lut, @intCast(value), &res, shift);
+            }
+            try std.testing.expectEqual(@as(usize, lut[value]) << shift, sum);
+            try std.testing.expectEqual(@as(Frac, 0), res);
+        }
+    }
+}
@@ -0,0 +1,453 @@
+/// compositor.zig
+/// Off-screen surfaces and masks that get combined with whole-row bit ops instead of set_pixel.
+/// A Surface is a FrameBuffer's packed data with every 24 bit row widened to a u32,
+/// so OR/AND/XOR/replace/tint over the whole cube is 64 word ops each.
+/// A Mask is 1 bit per voxel laid out the same way: a u64 per layer, byte r for row r, bit i for voxel i.
+/// Rows and voxels map to coordinates the same way as LayerData.getRow.
+/// On top of that sits a small stack of layers (scene, HUD, cursor, ...) that get composed into a frame,
+/// plus wipe & dissolve transitions between two surfaces.
+/// Compositor.present() and playTransition() are the only parts that touch the hardware, everything else runs on the host.
+const std = @import("std");
+const matrix = @import("matrix.zig");
+const deltaTime = @import("deltaTime.zig");
+const FrameBufferTypes = @import("frameBuffer.zig");
+const FrameBuffer = FrameBufferTypes.FrameBuffer;
+const Led = FrameBufferTypes.Led;
+
+const voxel_lsbs = FrameBufferTypes.row_voxel_lsbs;
+
+/// Byte of a mask row -> that row's voxels with all 3 channel bits set
+pub const expandLut: [256]u32 = genExpand: {
+    var lut: [256]u32 = undefined;
+    for (0..256) |byte| {
+        var out: u32 = 0;
+        for (0..8) |bit| {
+            if ((byte >> bit) & 1 == 1) {
+                out |= 0b111 << (3 * bit);
+            }
+        }
+        lut[byte] = out;
+    }
+    break :genExpand lut;
+};
+
+fn rowByte(mask: u64, row: usize) u8 {
+    return @truncate(mask >> @intCast(8 * row));
+}
+
+/// Every voxel of the row that has any channel on, with all 3 bits set
+fn litRow(row: u32) u32 {
+    return ((row | (row >> 1) | (row >> 2)) & voxel_lsbs) * 0b111;
+}
+
+pub const Axis = enum { x, y, z };
+
+pub const Mask = struct {
+    layers: [8]u64 = .{0} ** 8,
+
+    pub const all = Mask{ .layers = .{math_max_u64} ** 8 };
+    pub const none = Mask{};
+
+    pub fn set(self: *Mask, x: i32, y: i32, z: i32, on: bool) void {
+        const bit = @as(u64, 1) << @intCast(8 * (7 - x) + (7 - y));
+        if (on) {
+            self.layers[@intCast(z)] |= bit;
+        } else {
+            self.layers[@intCast(z)] &= ~bit;
+        }
+    }
+
+    pub fn get(self: *const Mask, x: i32, y: i32, z: i32) bool {
+        return (self.layers[@intCast(z)] >> @intCast(8 * (7 - x) + (7 - y))) & 1 == 1;
+    }
+
+    pub fn invert(self: Mask) Mask {
+        var out = self;
+        for (&out.layers) |*l| {
+            l.* = ~l.*;
+        }
+        return out;
+    }
+
+    pub fn intersect(self: Mask, other: Mask) Mask {
+        var out = self;
+        for (&out.layers, other.layers) |*l, o| {
+            l.* &= o;
+        }
+        return out;
+    }
+
+    pub fn unite(self: Mask, other: Mask) Mask {
+        var out = self;
+        for (&out.layers, other.layers) |*l, o| {
+            l.* |= o;
+        }
+        return out;
+    }
+
+    pub fn count(self: *const Mask) u32 {
+        var total: u32 = 0;
+        for (self.layers) |l| {
+            total += @popCount(l);
+        }
+        return total;
+    }
+
+    /// Every voxel whose coordinate along axis is < n. Used for wipes
+    pub fn halfSpace(axis: Axis, n: u4) Mask {
+        var out = Mask{};
+        if (n == 0) {
+            return out;
+        }
+        const k: u6 = @intCast(@min(n, 8) - 1);
+        switch (axis) {
+            // Layer z is z
+            .z => {
+                for (0..@min(n, 8)) |z| {
+                    out.layers[z] = math_max_u64;
+                }
+            },
+            // Row r holds x = 7 - r, so x < n is the top n bytes
+            .x => {
+                const rows = ~((@as(u64, 1) << (8 * (7 - k))) - 1);
+                out.layers = .{rows} ** 8;
+            },
+            // Voxel i holds y = 7 - i, so y < n is the top n bits of every byte
+            .y => {
+                const bits: u64 = @as(u8, 0xFF) << @intCast(7 - k);
+                out.layers = .{bits * 0x0101_0101_0101_0101} ** 8;
+            },
+        }
+        return out;
+    }
+
+    /// A pseudo-random progress-ordered subset of the cube.
+    /// progress 0 is empty, 255 is everything, and the set only ever grows with progress.
+    /// Bit-sliced compare against comptime thresholds, 16 word ops per layer.
+    pub fn dissolve(progress: u8) Mask {
+        var out = Mask{};
+        for (&out.layers, 0..) |*l, z| {
+            var lt: u64 = 0;
+            var eq: u64 = math_max_u64;
+            var bit: u4 = 8;
+            while (bit > 0) {
+                bit -= 1;
+                const plane = dissolvePlanes[bit][z];
+                if ((progress >> @intCast(bit)) & 1 == 1) {
+                    lt |= eq & ~plane;
+                    eq &= plane;
+                } else {
+                    eq &= ~plane;
+                }
+            }
+            l.* = lt;
+        }
+        return out;
+    }
+};
+
+const math_max_u64: u64 = std.math.maxInt(u64);
+
+/// Bit b of every voxel's dissolve threshold. Thresholds are in 0..254, so progress 255 covers all of them
+const dissolvePlanes: [8][8]u64 = genPlanes: {
+    @setEvalBranchQuota(100_000);
+    var planes: [8][8]u64 = .{.{0} ** 8} ** 8;
+    // xorshift32
+    var state: u32 = 0x1234_5678;
+    for (0..8) |z| {
+        for (0..64) |i| {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            const threshold = state % 255;
+            for (0..8) |b| {
+                if ((threshold >> b) & 1 == 1) {
+                    planes[b][z] |= 1 << i;
+                }
+            }
+        }
+    }
+    break :genPlanes planes;
+};
+
+pub const Surface = struct {
+    rows: [8][8]u32 = .{.{0} ** 8} ** 8,
+
+    pub fn set_pixel(self: *Surface, x: i32, y: i32, z: i32, color: Led) void {
+        const shift: u5 = @intCast(3 * (7 - y));
+        const row = &self.rows[@intCast(z)][@intCast(7 - x)];
+        row.* = (row.* & ~(@as(u32, 0b111) << shift)) | (@as(u32, @as(u3, @bitCast(color))) << shift);
+    }
+
+    pub fn clear(self: *Surface, color: Led) void {
+        self.rows = .{.{FrameBufferTypes.rowPattern(color)} ** 8} ** 8;
+    }
+
+    pub fn fromFrame(frame: *const FrameBuffer) Surface {
+        var out = Surface{};
+        for (&out.rows, &frame.layers) |*layer, *data| {
+            for (layer, 0..) |*row, r| {
+                row.* = data.getRow(@intCast(r));
+            }
+        }
+        return out;
+    }
+
+    pub fn present(self: *const Surface, frame: *FrameBuffer) void {
+        for (self.rows, &frame.layers) |layer, *data| {
+            for (layer, 0..) |row, r| {
+                data.setRow(@intCast(r), row);
+            }
+        }
+    }
+
+    /// Voxels with any channel on
+    pub fn litMask(self: *const Surface) Mask {
+        var out = Mask{};
+        for (self.rows, &out.layers) |layer, *m| {
+            for (layer, 0..) |row, r| {
+                const lit = litRow(row);
+                var byte: u64 = 0;
+                for (0..8) |i| {
+                    byte |= @as(u64, (lit >> @intCast(3 * i)) & 1) << @intCast(i);
+                }
+                m.* |= byte << @intCast(8 * r);
+            }
+        }
+        return out;
+    }
+
+    pub fn bitOr(self: *Surface, src: *const Surface) void {
+        for (&self.rows, src.rows) |*layer, srcLayer| {
+            for (layer, srcLayer) |*row, s| {
+                row.* |= s;
+            }
+        }
+    }
+
+    pub fn bitAnd(self: *Surface, src: *const Surface) void {
+        for (&self.rows, src.rows) |*layer, srcLayer| {
+            for (layer, srcLayer) |*row, s| {
+                row.* &= s;
+            }
+        }
+    }
+
+    pub fn bitXor(self: *Surface, src: *const Surface) void {
+        for (&self.rows, src.rows) |*layer, srcLayer| {
+            for (layer, srcLayer) |*row, s| {
+                row.* ^= s;
+            }
+        }
+    }
+
+    /// Takes src's voxels wherever mask is set
+    pub fn maskReplace(self: *Surface, src: *const Surface, mask: *const Mask) void {
+        for (&self.rows, src.rows, mask.layers) |*layer, srcLayer, m| {
+            for (layer, srcLayer, 0..) |*row, s, r| {
+                const expanded = expandLut[rowByte(m, r)];
+                row.* = (row.* & ~expanded) | (s & expanded);
+            }
+        }
+    }
+
+    /// Draws src on top: its lit voxels (under mask) replace ours, its dark ones are see-through
+    pub fn over(self: *Surface, src: *const Surface, mask: *const Mask) void {
+        for (&self.rows, src.rows, mask.layers) |*layer, srcLayer, m| {
+            for (layer, srcLayer, 0..) |*row, s, r| {
+                const expanded = expandLut[rowByte(m, r)] & litRow(s);
+                row.* = (row.* & ~expanded) | (s & expanded);
+            }
+        }
+    }
+
+    /// Recolours the lit voxels under mask
+    pub fn tint(self: *Surface, mask: *const Mask, color: Led) void {
+        const pattern = FrameBufferTypes.rowPattern(color);
+        for (&self.rows, mask.layers) |*layer, m| {
+            for (layer, 0..) |*row, r| {
+                const expanded = expandLut[rowByte(m, r)] & litRow(row.*);
+                row.* = (row.* & ~expanded) | (pattern & expanded);
+            }
+        }
+    }
+};
+
+// ----------
+// Layering
+// ----------
+
+pub const BlendOp = enum { over, replace, bitOr, bitAnd, bitXor, tint };
+
+pub const Layer = struct {
+    surface: Surface = .{},
+    /// Which voxels this layer is allowed to touch. Ignored by the bitwise ops
+    mask: Mask = Mask.all,
+    op: BlendOp = .over,
+    /// Only for .tint
+    tintColor: Led = .{ .r = 0, .g = 0, .b = 0 },
+    visible: bool = true,
+};
+
+pub const max_layers = 4;
+
+/// Layers are composed bottom (0) to top. Layer 0 is the base, its op is ignored
+pub const Compositor = struct {
+    layers: [max_layers]Layer = .{Layer{}} ** max_layers,
+
+    pub fn compose(self: *const Compositor, out: *Surface) void {
+        out.* = self.layers[0].surface;
+        for (self.layers[1..]) |*layer| {
+            if (!layer.visible) {
+                continue;
+            }
+            switch (layer.op) {
+                .over => out.over(&layer.surface, &layer.mask),
+                .replace => out.maskReplace(&layer.surface, &layer.mask),
+                .bitOr => out.bitOr(&layer.surface),
+                .bitAnd => out.bitAnd(&layer.surface),
+                .bitXor => out.bitXor(&layer.surface),
+                .tint => out.tint(&layer.mask, layer.tintColor),
+            }
+        }
+    }
+
+    /// Composes straight into the matrix draw buffer and renders it
+    pub fn present(self: *const Compositor) void {
+        var out: Surface = undefined;
+        self.compose(&out);
+        out.present(matrix.getDrawBuffer());
+        matrix.render();
+    }
+};
+
+// ------------
+// Transitions
+// ------------
+
+pub const Transition = union(enum) {
+    /// Sweeps to along the axis, from coordinate 0 up
+    wipe: Axis,
+    dissolve,
+};
+
+/// Frame of a transition. progress goes 0 (all from) to 255 (all to)
+pub fn transitionFrame(from: *const Surface, to: *const Surface, effect: Transition, progress: u8, out: *Surface) void {
+    const mask = switch (effect) {
+        .wipe => |axis| Mask.halfSpace(axis, @intCast((@as(u16, progress) * 8 + 254) / 255)),
+        .dissolve => Mask.dissolve(progress),
+    };
+    out.* = from.*;
+    out.maskReplace(to, &mask);
+}
+
+/// Plays a whole transition on the cube. Blocks for duration_ms
+pub fn playTransition(from: *const Surface, to: *const Surface, effect: Transition, duration_ms: u32) void {
+    var dt: deltaTime.DeltaTime = .{};
+    dt.start();
+    var elapsed: u32 = 0;
+    var out: Surface = undefined;
+    while (elapsed < duration_ms) {
+        transitionFrame(from, to, effect, @intCast(elapsed * 255 / duration_ms), &out);
+        out.present(matrix.getDrawBuffer());
+        matrix.render();
+        elapsed += dt.milli();
+    }
+    to.present(matrix.getDrawBuffer());
+    matrix.render();
+}
+
+const red = Led{ .r = 1, .g = 0, .b = 0 };
+const blue = Led{ .r = 0, .g = 0, .b = 1 };
+
+/// Red and blue voxel, far apart
+fn testSurface() Surface {
+    var surf = Surface{};
+    surf.set_pixel(1, 6, 2, red);
+    surf.set_pixel(5, 0, 7, blue);
+    return surf;
+}
+
+test "surface packing agrees with FrameBuffer.set_pixel" {
+    const surf = testSurface();
+    var frame = FrameBuffer{};
+    surf.present(&frame);
+    var reference = FrameBuffer{};
+    reference.set_pixel(1, 6, 2, red);
+    reference.set_pixel(5, 0, 7, blue);
+    try std.testing.expect(std.mem.eql(u8, std.mem.asBytes(&frame), std.mem.asBytes(&reference)));
+    try std.testing.expect(std.mem.eql(u32, &Surface.fromFrame(&frame).rows[2], &surf.rows[2]));
+
+    // Lit mask finds exactly those two, and Mask.set agrees with it
+    const lit = surf.litMask();
+    var expected = Mask{};
+    expected.set(1, 6, 2, true);
+    expected.set(5, 0, 7, true);
+    try std.testing.expect(std.mem.eql(u64, &lit.layers, &expected.layers));
+}
+
+test "blend ops" {
+    const surf = testSurface();
+
+    // over: a lit HUD voxel wins, a dark one shows what's under it
+    var hud = Surface{};
+    hud.set_pixel(1, 6, 2, blue);
+    var scene = surf;
+    scene.over(&hud, &Mask.all);
+    try std.testing.expect(std.mem.eql(u32, &scene.rows[2], &hud.rows[2]));
+    try std.testing.expect(std.mem.eql(u32, &scene.rows[7], &surf.rows[7]));
+
+    // x ^ x = 0, and tint recolours without lighting anything new
+    var x = surf;
+    x.bitXor(&surf);
+    try std.testing.expect(x.litMask().count() == 0);
+    var tinted = surf;
+    tinted.tint(&Mask.all, blue);
+    try std.testing.expect(tinted.litMask().count() == 2);
+    try std.testing.expect(std.mem.eql(u32, &tinted.rows[7], &surf.rows[7]));
+}
+
+test "layers compose bottom to top" {
+    var comp = Compositor{};
+    comp.layers[0].surface = testSurface();
+    comp.layers[1].surface.set_pixel(1, 6, 2, blue);
+    comp.layers[2].op = .tint;
+    comp.layers[2].mask = Mask.halfSpace(.z, 7);
+    comp.layers[2].tintColor = .{ .r = 0, .g = 1, .b = 0 };
+    comp.layers[3].surface.set_pixel(0, 0, 0, red);
+    comp.layers[3].visible = false;
+    var out: Surface = undefined;
+    comp.compose(&out);
+
+    var expected = Surface{};
+    expected.set_pixel(1, 6, 2, .{ .r = 0, .g = 1, .b = 0 });
+    expected.set_pixel(5, 0, 7, blue);
+    try std.testing.expect(std.mem.eql(u8, std.mem.asBytes(&out), std.mem.asBytes(&expected)));
+}
+
+test "masks" {
+    // Wipes cover n slices of 64
+    for ([_]Axis{ .x, .y, .z }) |axis| {
+        for (0..9) |n| {
+            const m = Mask.halfSpace(axis, @intCast(n));
+            try std.testing.expect(m.count() == 64 * n);
+        }
+    }
+    try std.testing.expect(Mask.halfSpace(.x, 3).get(2, 7, 7));
+    try std.testing.expect(!Mask.halfSpace(.x, 3).get(3, 0, 0));
+    try std.testing.expect(Mask.halfSpace(.y, 1).get(7, 0, 4));
+    try std.testing.expect(!Mask.halfSpace(.y, 1).get(0, 1, 0));
+}
+
+test "dissolve grows from nothing to everything" {
+    try std.testing.expect(Mask.dissolve(0).count() == 0);
+    try std.testing.expect(Mask.dissolve(128).count() > 128 and Mask.dissolve(128).count() < 384);
+    try std.testing.expect(Mask.dissolve(255).count() == 512);
+    var prev = Mask.dissolve(0);
+    var p: u16 = 16;
+    while (p < 256) : (p += 16) {
+        const cur = Mask.dissolve(@intCast(p));
+        try std.testing.expect(std.mem.eql(u64, &cur.intersect(prev).layers, &prev.layers));
+        prev = cur;
+    }
+}
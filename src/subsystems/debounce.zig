@@ -1,9 +1,17 @@
+/// debounce.zig
+/// Debounces the buttons and joystick.
+/// TIM14 only samples the inputs and pends PendSV (see init/interrupts.zig). The shifting and edge detection
+/// run from PendSV at the lowest priority, where they can't hold up a BAM plane.
 const microzig = @import("microzig");
 const cImport = @import("../cImport.zig");
 const Joystick = @import("../subsystems/joystick.zig");
 const Button_A = @import("../subsystems/button_a.zig");
 const Button_B = @import("../subsystems/button_b.zig");
 const Screen = @import("../subsystems/screen.zig");
+const deltaTime = @import("../subsystems/deltaTime.zig");
+const Latency = @import("../util/latency.zig");
+const Interrupts = @import("../init/interrupts.zig");
+const Source = @import("../util/trace.zig").Source;
 const cmsis = cImport.cmsis;
 const peripherals = microzig.chip.peripherals;
 const periph_types = microzig.chip.types.peripherals;
@@ -11,78 +19,135 @@ const RCC = peripherals.RCC;
 const TIM14 = peripherals.TIM14;
 const GPIOC = peripherals.GPIOC;
 
+/// Raw level of every input, bit n is the Source with value n, and when they were read
+const Sample = struct {
+    levels: u8,
+    now: u32,
+};
+
+/// Samples process() hasn't got to yet. TIM14 only moves head and process() only moves tail
+var queue: [4]Sample = undefined;
+var queueHead: u8 = 0;
+var queueTail: u8 = 0;
+/// Samples dropped because PendSV was held off for a whole queue's worth of TIM14 periods
+pub var overruns: u32 = 0;
+
+fn bit(source: Source) u8 {
+    return @as(u8, 1) << @intCast(@intFromEnum(source));
+}
+
+fn readLevels() u8 {
+    var levels: u8 = 0;
+    const idr = cImport.cmsis.GPIOC.*.IDR;
+    if (idr & cImport.cmsis.GPIO_IDR_4 != 0) levels |= bit(.button_a);
+    if (idr & cImport.cmsis.GPIO_IDR_3 != 0) levels |= bit(.button_b);
+    if (idr & cImport.cmsis.GPIO_IDR_2 != 0) levels |= bit(.joystick_button);
+    if (Joystick.is_in_range(.UP)) levels |= bit(.joystick_up);
+    if (Joystick.is_in_range(.DOWN)) levels |= bit(.joystick_down);
+    if (Joystick.is_in_range(.LEFT)) levels |= bit(.joystick_left);
+    if (Joystick.is_in_range(.RIGHT)) levels |= bit(.joystick_right);
+    return levels;
+}
+
 pub export fn TIM14_IRQHandler() callconv(.C) void {
     TIM14.SR.modify(.{
         .UIF = 0,
     });
-
-    // button_a memory byte
-    if (cImport.cmsis.GPIOC.*.IDR & cImport.cmsis.GPIO_IDR_4 != 0) {
-        Button_A.memory_byte_shift(1);
+    if (queueHead -% queueTail >= queue.len) {
+        overruns += 1;
     } else {
-        Button_A.memory_byte_shift(0);
+        queue[queueHead % queue.len] = .{ .levels = readLevels(), .now = deltaTime.millis() };
+        queueHead +%= 1;
     }
-    if (Button_A.memory_byte_full() and Button_A.cur() == false) {
-        Button_A.update_pressed();
+    Interrupts.pendDeferred();
+}
+
+/// Everything TIM14 sampled since last time. From PendSV
+pub fn process() void {
+    while (queueTail != queueHead) {
+        debounce(queue[queueTail % queue.len]);
+        queueTail +%= 1;
     }
+}
 
-    // button_b memory byte
-    if (cImport.cmsis.GPIOC.*.IDR & cImport.cmsis.GPIO_IDR_3 != 0) {
-        Button_B.memory_byte_shift(1);
-    } else {
-        Button_B.memory_byte_shift(0);
+fn debounce(sample: Sample) void {
+    // Raw samples and accepted edges also go to latency tracking
+    const now = sample.now;
+
+    // button_a memory byte
+    {
+        const high = sample.levels & bit(.button_a) != 0;
+        Button_A.memory_byte_shift(@intFromBool(high));
+        Latency.tracker.sample(.button_a, high, now);
+        if (Button_A.memory_byte_full() and Button_A.cur() == false) {
+            Button_A.update_pressed();
+            Latency.tracker.capture(.button_a);
+        }
     }
-    if (Button_B.memory_byte_full() and Button_B.cur() == false) {
-        Button_B.update_pressed();
+
+    // button_b memory byte
+    {
+        const high = sample.levels & bit(.button_b) != 0;
+        Button_B.memory_byte_shift(@intFromBool(high));
+        Latency.tracker.sample(.button_b, high, now);
+        if (Button_B.memory_byte_full() and Button_B.cur() == false) {
+            Button_B.update_pressed();
+            Latency.tracker.capture(.button_b);
+        }
     }
 
     // joystick memory byte
-    if (cImport.cmsis.GPIOC.*.IDR & cImport.cmsis.GPIO_IDR_2 != 0) {
-        Joystick.memory_byte_shift(.BUTTON, 1);
-    } else {
-        Joystick.memory_byte_shift(.BUTTON, 0);
-    }
-    if (Joystick.memory_byte_full(.BUTTON) and Joystick.cur(.BUTTON) == false) {
-        Joystick.update_cur_value(.BUTTON);
+    {
+        const high = sample.levels & bit(.joystick_button) != 0;
+        Joystick.memory_byte_shift(.BUTTON, @intFromBool(high));
+        Latency.tracker.sample(.joystick_button, high, now);
+        if (Joystick.memory_byte_full(.BUTTON) and Joystick.cur(.BUTTON) == false) {
+            Joystick.update_cur_value(.BUTTON);
+            Latency.tracker.capture(.joystick_button);
+        }
     }
 
     // up memory byte
-    if (Joystick.is_in_range(.UP)) {
-        Joystick.memory_byte_shift(.UP, 1);
-    } else {
-        Joystick.memory_byte_shift(.UP, 0);
-    }
-    if (Joystick.memory_byte_full(.UP) and Joystick.cur(.UP) == false) {
-        Joystick.update_cur_value(.UP);
+    {
+        const high = sample.levels & bit(.joystick_up) != 0;
+        Joystick.memory_byte_shift(.UP, @intFromBool(high));
+        Latency.tracker.sample(.joystick_up, high, now);
+        if (Joystick.memory_byte_full(.UP) and Joystick.cur(.UP) == false) {
+            Joystick.update_cur_value(.UP);
+            Latency.tracker.capture(.joystick_up);
+        }
     }
 
     // down memory byte
-    if (Joystick.is_in_range(.DOWN)) {
-        Joystick.memory_byte_shift(.DOWN, 1);
-    } else {
-        Joystick.memory_byte_shift(.DOWN, 0);
-    }
-    if (Joystick.memory_byte_full(.DOWN) and Joystick.cur(.DOWN) == false) {
-        Joystick.update_cur_value(.DOWN);
+    {
+        const high = sample.levels & bit(.joystick_down) != 0;
+        Joystick.memory_byte_shift(.DOWN, @intFromBool(high));
+        Latency.tracker.sample(.joystick_down, high, now);
+        if (Joystick.memory_byte_full(.DOWN) and Joystick.cur(.DOWN) == false) {
+            Joystick.update_cur_value(.DOWN);
+            Latency.tracker.capture(.joystick_down);
+        }
     }
 
     // left memory byte
-    if (Joystick.is_in_range(.LEFT)) {
-        Joystick.memory_byte_shift(.LEFT, 1);
-    } else {
-        Joystick.memory_byte_shift(.LEFT, 0);
-    }
-    if (Joystick.memory_byte_full(.LEFT) and Joystick.cur(.LEFT) == false) {
-        Joystick.update_cur_value(.LEFT);
+    {
+        const high = sample.levels & bit(.joystick_left) != 0;
+        Joystick.memory_byte_shift(.LEFT, @intFromBool(high));
+        Latency.tracker.sample(.joystick_left, high, now);
+        if (Joystick.memory_byte_full(.LEFT) and Joystick.cur(.LEFT) == false) {
+            Joystick.update_cur_value(.LEFT);
+            Latency.tracker.capture(.joystick_left);
+        }
     }
 
     // right memory byte
-    if (Joystick.is_in_range(.RIGHT)) {
-        Joystick.memory_byte_shift(.RIGHT, 1);
-    } else {
-        Joystick.memory_byte_shift(.RIGHT, 0);
-    }
-    if (Joystick.memory_byte_full(.RIGHT) and Joystick.cur(.RIGHT) == false) {
-        Joystick.update_cur_value(.RIGHT);
+    {
+        const high = sample.levels & bit(.joystick_right) != 0;
+        Joystick.memory_byte_shift(.RIGHT, @intFromBool(high));
+        Latency.tracker.sample(.joystick_right, high, now);
+        if (Joystick.memory_byte_full(.RIGHT) and Joystick.cur(.RIGHT) == false) {
+            Joystick.update_cur_value(.RIGHT);
+            Latency.tracker.capture(.joystick_right);
+        }
     }
 }
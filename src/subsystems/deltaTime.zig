@@ -3,6 +3,7 @@
 const microzig = @import("microzig");
 const cImport = @import("../cImport.zig");
 const cmsis = cImport.cmsis;
+const Trace = @import("../util/trace.zig");
 const peripherals = microzig.chip.peripherals;
 const RCC = peripherals.RCC;
 const TIM3 = peripherals.TIM3;
@@ -35,6 +36,12 @@ pub fn init() void {
 /// WARN: this timestamp resets to 0 every ~65.5 seconds,
 /// so do not use for long term time measurnments. Best used for a random seed.
 pub fn timestamp() callconv(.C) u32 {
+    return Trace.seed(@bitCast(TIM3.CNT));
+}
+
+/// Raw ms count since init(), for timing things outside of apps. Not recorded by Trace.
+/// Wraps to 0 every ~65.5 seconds like timestamp()
+pub fn millis() u32 {
     return @bitCast(TIM3.CNT);
 }
 
@@ -52,9 +59,9 @@ pub const DeltaTime = struct {
         self.currTime = @bitCast(TIM3.CNT);
 
         if (startTime < self.currTime) {
-            return self.currTime - startTime;
+            return Trace.time(self.currTime - startTime);
         } else if (startTime > self.currTime) {
-            return maxTimARR - startTime + self.currTime;
+            return Trace.time(maxTimARR - startTime + self.currTime);
         } else {
             // WARN: realllly scuffed
             cImport.nano_wait(3000000); // wait a couple milli seconds
@@ -77,9 +84,9 @@ pub export fn dtMilli(dt: *cImport.DeltaTime) callconv(.C) c_uint {
     dt.currTime = @bitCast(TIM3.CNT);
 
     if (startTime < dt.currTime) {
-        return dt.currTime - startTime;
+        return Trace.time(dt.currTime - startTime);
     } else if (startTime > dt.currTime) {
-        return maxTimARR - startTime + dt.currTime;
+        return Trace.time(maxTimARR - startTime + dt.currTime);
     } else {
         // WARN: realllly scuffed
         cImport.nano_wait(3000000); // wait a couple milli seconds
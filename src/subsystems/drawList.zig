@@ -0,0 +1,597 @@
+/// drawList.zig
+/// Batched drawing. Apps append compact commands to a fixed size list,
+/// then submit() rasterizes the whole list into the frame in one go.
+/// Submission goes layer by layer, and each command only touches the rows it covers in that layer,
+/// so a box or a clear costs a handful of row writes instead of hundreds of set_pixel calls.
+/// Commands are applied in the order they were added, so later ones draw over earlier ones.
+/// C apps get the same thing through the draw* functions in application.h
+/// submit() is the only part that touches the hardware, everything else runs on the host.
+const std = @import("std");
+const matrix = @import("matrix.zig");
+const FrameBufferTypes = @import("frameBuffer.zig");
+const LayerData = FrameBufferTypes.LayerData;
+const FrameBuffer = FrameBufferTypes.FrameBuffer;
+const Led = FrameBufferTypes.Led;
+
+pub const capacity = 128;
+
+pub const Op = enum(u8) { voxel, span, box, line, sphere, blit, clear };
+pub const Axis = enum(u2) { x, y, z };
+
+/// Kept small so a full list is about 2KB. a & b are positions, except where noted in the DrawList methods and walkLine()
+pub const Command = struct {
+    op: Op,
+    color: Led,
+    a: [3]i8 = .{ 0, 0, 0 },
+    b: [3]i8 = .{ 0, 0, 0 },
+    /// Blit bitmap. Byte x, bit y
+    bits: u64 = 0,
+
+    /// Layers this command can touch, inclusive
+    fn zRange(self: *const Command) [2]i32 {
+        const a: i32 = self.a[2];
+        const b: i32 = self.b[2];
+        return switch (self.op) {
+            .voxel, .blit => .{ a, a },
+            .span => if (self.b[0] == @intFromEnum(Axis.z)) .{ a, a + self.b[1] - 1 } else .{ a, a },
+            .box => .{ @min(a, b), @max(a, b) },
+            .line => .{ self.b[1], self.b[2] },
+            .sphere => .{ a - self.b[0], a + self.b[0] },
+            .clear => .{ 0, 7 },
+        };
+    }
+};
+
+pub const DrawList = struct {
+    cmds: [capacity]Command = undefined,
+    len: usize = 0,
+    /// Commands that didn't fit since the last submit
+    dropped: u32 = 0,
+
+    fn push(self: *DrawList, cmd: Command) bool {
+        if (self.len == capacity) {
+            self.dropped += 1;
+            return false;
+        }
+        self.cmds[self.len] = cmd;
+        self.len += 1;
+        return true;
+    }
+
+    pub fn voxel(self: *DrawList, x: i32, y: i32, z: i32, color: Led) bool {
+        return self.push(.{ .op = .voxel, .color = color, .a = pos(x, y, z) });
+    }
+
+    /// len voxels starting at (x, y, z) going along axis. Only the part on the cube gets added, however far out it starts
+    pub fn span(self: *DrawList, x: i32, y: i32, z: i32, axis: Axis, len: i32, color: Led) bool {
+        var p = [3]i64{ x, y, z };
+        const along = @intFromEnum(axis);
+        for (p, 0..) |c, i| {
+            if (i != along and !inCube(c)) {
+                return true;
+            }
+        }
+        // [start, start + len) clipped to the cube, in i64 so nothing near the ends of i32 wraps
+        const lo = @max(p[along], 0);
+        const hi = @min(p[along] + len, 8);
+        if (lo >= hi) {
+            return true;
+        }
+        p[along] = lo;
+        return self.push(.{
+            .op = .span,
+            .color = color,
+            .a = .{ @intCast(p[0]), @intCast(p[1]), @intCast(p[2]) },
+            .b = .{ @intFromEnum(axis), @intCast(hi - lo), 0 },
+        });
+    }
+
+    /// Filled box between two corners, both inclusive
+    pub fn box(self: *DrawList, x0: i32, y0: i32, z0: i32, x1: i32, y1: i32, z1: i32, color: Led) bool {
+        return self.push(.{
+            .op = .box,
+            .color = color,
+            .a = pos(@min(x0, x1), @min(y0, y1), @min(z0, z1)),
+            .b = pos(@max(x0, x1), @max(y0, y1), @max(z0, z1)),
+        });
+    }
+
+    /// 3d Bresenham line between two voxels, both inclusive. The ends can be anywhere, only the part on the cube gets drawn
+    pub fn line(self: *DrawList, x0: i32, y0: i32, z0: i32, x1: i32, y1: i32, z1: i32, color: Led) bool {
+        return self.push(walkLine(.{ x0, y0, z0 }, .{ x1, y1, z1 }, color));
+    }
+
+    /// Solid sphere. Voxels within radius + 0.5 of the center are filled. Ones that miss the cube aren't added.
+    /// A sphere whose centre or radius doesn't fit in a Command gets drawn into one blit per layer it covers
+    /// when it's added, so a huge one far off the cube still cuts through it in the right place
+    pub fn sphere(self: *DrawList, x: i32, y: i32, z: i32, radius: i32, color: Led) bool {
+        const c = [3]i64{ x, y, z };
+        const r: i64 = @max(radius, 0);
+        // (r + 0.5)^2 = r^2 + r + 0.25, and the 0.25 never matters for integer distances
+        const limit: u64 = @intCast(r * r + r);
+        // Squared distance from the centre to the nearest voxel of the cube
+        var gap: u64 = 0;
+        for (c) |ci| {
+            const d: u64 = @intCast(if (ci < 0) -ci else if (ci > 7) ci - 7 else 0);
+            if (d > r) {
+                return true;
+            }
+            gap += d * d;
+        }
+        if (gap > limit) {
+            return true;
+        }
+
+        var fits = r <= 15;
+        for (c) |ci| {
+            fits = fits and ci >= -8 and ci <= 15;
+        }
+        if (fits) {
+            return self.push(.{ .op = .sphere, .color = color, .a = .{ @intCast(x), @intCast(y), @intCast(z) }, .b = .{ @intCast(r), 0, 0 } });
+        }
+
+        var layers: [8]u64 = undefined;
+        var count: usize = 0;
+        for (&layers, 0..) |*bits, layer| {
+            bits.* = sphereLayer(c, limit, @intCast(layer));
+            count += @intFromBool(bits.* != 0);
+        }
+        // All of it or none of it
+        if (self.len + count > capacity) {
+            self.dropped += 1;
+            return false;
+        }
+        for (layers, 0..) |bits, layer| {
+            if (bits != 0) {
+                _ = self.blit(@intCast(layer), bits, color);
+            }
+        }
+        return true;
+    }
+
+    /// Stamps an 8x8 bitmap onto layer z. Byte x of bits holds the voxels of that x, bit y set = draw (x, y)
+    pub fn blit(self: *DrawList, z: i32, bits: u64, color: Led) bool {
+        return self.push(.{ .op = .blit, .color = color, .a = pos(0, 0, z), .bits = bits });
+    }
+
+    /// Fills the whole frame. Usually the first command of a frame
+    pub fn clear(self: *DrawList, color: Led) bool {
+        return self.push(.{ .op = .clear, .color = color });
+    }
+
+    pub fn reset(self: *DrawList) void {
+        self.len = 0;
+        self.dropped = 0;
+    }
+
+    /// Rasterizes every command into target, one layer at a time
+    pub fn execute(self: *const DrawList, target: *FrameBuffer) void {
+        for (&target.layers, 0..) |*layer, z_| {
+            const z: i32 = @intCast(z_);
+            for (self.cmds[0..self.len]) |*cmd| {
+                const range = cmd.zRange();
+                if (z < range[0] or z > range[1]) {
+                    continue;
+                }
+                drawInLayer(cmd, layer, z);
+            }
+        }
+    }
+
+    /// Draws everything into the matrix draw buffer, renders it, and empties the list
+    pub fn submit(self: *DrawList) void {
+        self.execute(matrix.getDrawBuffer());
+        matrix.render();
+        self.reset();
+    }
+};
+
+fn clip(v: i32, lo: i32, hi: i32) i8 {
+    return @intCast(std.math.clamp(v, lo, hi));
+}
+
+// For voxels, boxes and blits, anything off the cube by more than a cube length is as good as infinitely far.
+// Spans, lines and spheres would change shape, so they get clipped their own way
+fn pos(x: i32, y: i32, z: i32) [3]i8 {
+    return .{ clip(x, -8, 15), clip(y, -8, 15), clip(z, -8, 15) };
+}
+
+// -----------------
+// Per layer raster
+// -----------------
+
+/// Mask for voxels y0..y1 (inclusive, already clipped) of a row. y counts down the row, see LayerData.getRow
+fn rowMask(y0: i32, y1: i32) u32 {
+    const lo: u5 = @intCast(3 * (7 - y1));
+    const hi: u5 = @intCast(3 * (8 - y0));
+    return ((@as(u32, 1) << hi) - 1) & ~((@as(u32, 1) << lo) - 1);
+}
+
+fn rowOf(x: i32) u3 {
+    return @intCast(7 - x);
+}
+
+fn signum(v: i64) i32 {
+    return if (v > 0) 1 else if (v < 0) -1 else 0;
+}
+
+/// Lines get walked when they're added, since their ends don't fit in a Command.
+/// Only steps where the major axis is on the cube can land on it, so there are 8 at most.
+/// a is (major axis, its value at the first of those steps, its direction), b is (steps, lowest z, highest z).
+/// Byte i of bits is step i: bit 7 set when the voxel is on the cube, bits 0..2 and 3..5 the other two axes
+fn walkLine(from: [3]i32, to: [3]i32, color: Led) Command {
+    var d: [3]i64 = undefined;
+    var s: [3]i32 = undefined;
+    for (&d, &s, from, to) |*di, *si, f, t| {
+        di.* = @intCast(@abs(@as(i64, t) - f));
+        si.* = signum(@as(i64, t) - f);
+    }
+    const major: usize = if (d[0] >= d[1] and d[0] >= d[2]) 0 else if (d[1] >= d[2]) 1 else 2;
+    const m1 = (major + 1) % 3;
+    const m2 = (major + 2) % 3;
+    const dir: i32 = if (s[major] < 0) -1 else 1;
+
+    // Steps k that put the major axis on 0..7
+    const start: i64 = from[major];
+    const first = @max(0, if (dir > 0) -start else start - 7);
+    const last = @min(d[major], if (dir > 0) 7 - start else start);
+    var cmd = Command{ .op = .line, .color = color, .b = .{ 0, 7, 0 } };
+    if (first > last) {
+        return cmd;
+    }
+    cmd.a = .{ @intCast(major), @intCast(start + dir * first), @intCast(dir) };
+    cmd.b[0] = @intCast(last - first + 1);
+
+    var k = first;
+    while (k <= last) : (k += 1) {
+        var p: [3]i64 = undefined;
+        p[major] = start + dir * k;
+        for ([2]usize{ m1, m2 }) |m| {
+            // Bresenham's minor steps after k major ones, in closed form: the fewest n with 2 * d[major] * n
+            // at least 2 * d[m] * k - d[major]. i128 because k and d can both be near 2^32
+            const taken: i64 = if (d[major] == 0) 0 else @intCast(@max(0, -@divFloor(@as(i128, d[major]) - 2 * @as(i128, d[m]) * k, 2 * d[major])));
+            p[m] = from[m] + s[m] * taken;
+        }
+        if (inCube(p[m1]) and inCube(p[m2])) {
+            const step: u6 = @intCast(k - first);
+            cmd.bits |= (0x80 | @as(u64, @intCast(p[m1])) | @as(u64, @intCast(p[m2])) << 3) << (8 * step);
+            cmd.b[1] = @min(cmd.b[1], @as(i8, @intCast(p[2])));
+            cmd.b[2] = @max(cmd.b[2], @as(i8, @intCast(p[2])));
+        }
+    }
+    return cmd;
+}
+
+fn inCube(v: i64) bool {
+    return v >= 0 and v <= 7;
+}
+
+/// Layer z of a sphere as a blit bitmap. i128 since centre and radius can be anywhere in i32
+fn sphereLayer(c: [3]i64, limit: u64, z: i64) u64 {
+    var bits: u64 = 0;
+    const dz: i128 = z - c[2];
+    for (0..8) |x| {
+        const dx: i128 = @as(i64, @intCast(x)) - c[0];
+        const left = @as(i128, limit) - dx * dx - dz * dz;
+        if (left < 0) {
+            continue;
+        }
+        // Widest dy with dy^2 <= left. left <= limit < 2^63
+        const dy: i64 = std.math.sqrt(@as(u64, @intCast(left)));
+        var y: i64 = @max(c[1] - dy, 0);
+        while (y <= @min(c[1] + dy, 7)) : (y += 1) {
+            bits |= @as(u64, 1) << @intCast(8 * x + @as(usize, @intCast(y)));
+        }
+    }
+    return bits;
+}
+
+/// Fills y0..y1 of column x in the layer. Clips
+fn fillSpan(layer: *LayerData, x: i32, y0: i32, y1: i32, pattern: u32) void {
+    if (!inCube(x)) {
+        return;
+    }
+    const lo = @max(y0, 0);
+    const hi = @min(y1, 7);
+    if (lo > hi) {
+        return;
+    }
+    layer.writeRow(rowOf(x), rowMask(lo, hi), pattern);
+}
+
+fn plot(layer: *LayerData, x: i32, y: i32, pattern: u32) void {
+    if (inCube(y)) {
+        fillSpan(layer, x, y, y, pattern);
+    }
+}
+
+/// Spreads bit i of a byte out to voxel 7 - i of a row, since rows run from y = 7 down to y = 0
+const spreadLut: [256]u32 = genSpread: {
+    var lut: [256]u32 = undefined;
+    for (0..256) |byte| {
+        var out: u32 = 0;
+        for (0..8) |bit| {
+            if ((byte >> bit) & 1 == 1) {
+                out |= 1 << (3 * (7 - bit));
+            }
+        }
+        lut[byte] = out;
+    }
+    break :genSpread lut;
+};
+
+fn drawInLayer(cmd: *const Command, layer: *LayerData, z: i32) void {
+    const pattern = FrameBufferTypes.rowPattern(cmd.color);
+    const a = [3]i32{ cmd.a[0], cmd.a[1], cmd.a[2] };
+    const b = [3]i32{ cmd.b[0], cmd.b[1], cmd.b[2] };
+    switch (cmd.op) {
+        .voxel => plot(layer, a[0], a[1], pattern),
+        .span => switch (@as(Axis, @enumFromInt(b[0]))) {
+            .x => {
+                var x = a[0];
+                while (x < a[0] + b[1]) : (x += 1) {
+                    plot(layer, x, a[1], pattern);
+                }
+            },
+            .y => fillSpan(layer, a[0], a[1], a[1] + b[1] - 1, pattern),
+            .z => plot(layer, a[0], a[1], pattern),
+        },
+        .box => {
+            var x = @max(a[0], 0);
+            while (x <= @min(b[0], 7)) : (x += 1) {
+                fillSpan(layer, x, a[1], b[1], pattern);
+            }
+        },
+        .line => {
+            // Already walked by walkLine(), see there for the layout
+            const major: usize = @intCast(a[0]);
+            const m1 = (major + 1) % 3;
+            const m2 = (major + 2) % 3;
+            const steps: usize = @intCast(b[0]);
+            for (0..steps) |i| {
+                const byte: u8 = @truncate(cmd.bits >> @intCast(8 * i));
+                if (byte & 0x80 == 0) {
+                    continue;
+                }
+                var p: [3]i32 = undefined;
+                p[major] = a[1] + a[2] * @as(i32, @intCast(i));
+                p[m1] = byte & 0b111;
+                p[m2] = (byte >> 3) & 0b111;
+                if (p[2] == z) {
+                    plot(layer, p[0], p[1], pattern);
+                }
+            }
+        },
+        .sphere => {
+            // (r + 0.5)^2 = r^2 + r + 0.25, and the 0.25 never matters for integer distances
+            const r = b[0];
+            const dz = z - a[2];
+            const limit = r * r + r - dz * dz;
+            var x = @max(a[0] - r, 0);
+            while (x <= @min(a[0] + r, 7)) : (x += 1) {
+                const dx = x - a[0];
+                const left = limit - dx * dx;
+                if (left < 0) {
+                    continue;
+                }
+                // Widest dy with dy^2 <= left
+                var dy: i32 = 0;
+                while ((dy + 1) * (dy + 1) <= left) : (dy += 1) {}
+                fillSpan(layer, x, a[1] - dy, a[1] + dy, pattern);
+            }
+        },
+        .blit => {
+            for (0..8) |x| {
+                const byte: u8 = @truncate(cmd.bits >> @intCast(8 * x));
+                if (byte == 0) {
+                    continue;
+                }
+                const mask = spreadLut[byte] * 0b111;
+                layer.writeRow(rowOf(@intCast(x)), mask, pattern);
+            }
+        },
+        .clear => {
+            for (0..8) |row| {
+                layer.setRow(@intCast(row), pattern);
+            }
+        },
+    }
+}
+
+// The list everything outside of Zig (and anyone who doesn't want their own) uses
+pub var shared: DrawList = .{};
+
+// ------
+// Tests
+// ------
+
+const white = Led{ .r = 1, .g = 1, .b = 1 };
+
+fn drawn(list: *const DrawList) FrameBuffer {
+    var frame: FrameBuffer = .{};
+    list.execute(&frame);
+    return frame;
+}
+
+fn expectFrame(expected: *const FrameBuffer, actual: *const FrameBuffer) !void {
+    try std.testing.expectEqualSlices(u8, std.mem.asBytes(expected), std.mem.asBytes(actual));
+}
+
+/// Plain 3d Bresenham one voxel at a time, clipped only at set_pixel
+fn referenceLine(frame: *FrameBuffer, a: [3]i32, b: [3]i32, color: Led) void {
+    const d = [3]i32{ @intCast(@abs(b[0] - a[0])), @intCast(@abs(b[1] - a[1])), @intCast(@abs(b[2] - a[2])) };
+    const s = [3]i32{ signum(b[0] - a[0]), signum(b[1] - a[1]), signum(b[2] - a[2]) };
+    const major: usize = if (d[0] >= d[1] and d[0] >= d[2]) 0 else if (d[1] >= d[2]) 1 else 2;
+    const m1 = (major + 1) % 3;
+    const m2 = (major + 2) % 3;
+    var p = a;
+    var err1 = 2 * d[m1] - d[major];
+    var err2 = 2 * d[m2] - d[major];
+    var step: i32 = 0;
+    while (step <= d[major]) : (step += 1) {
+        if (inCube(p[0]) and inCube(p[1]) and inCube(p[2])) {
+            frame.set_pixel(@intCast(p[0]), @intCast(p[1]), @intCast(p[2]), color);
+        }
+        if (err1 > 0) {
+            p[m1] += s[m1];
+            err1 -= 2 * d[major];
+        }
+        if (err2 > 0) {
+            p[m2] += s[m2];
+            err2 -= 2 * d[major];
+        }
+        err1 += 2 * d[m1];
+        err2 += 2 * d[m2];
+        p[major] += s[major];
+    }
+}
+
+test "boxes and blits match set_pixel" {
+    var list: DrawList = .{};
+    _ = list.box(1, 2, 3, 4, 6, 5, white);
+    _ = list.blit(0, 0x0100_0000_0000_0081, white);
+
+    var reference: FrameBuffer = .{};
+    for (1..5) |x| {
+        for (2..7) |y| {
+            for (3..6) |z| {
+                reference.set_pixel(@intCast(x), @intCast(y), @intCast(z), white);
+            }
+        }
+    }
+    reference.set_pixel(0, 0, 0, white);
+    reference.set_pixel(0, 7, 0, white);
+    reference.set_pixel(7, 0, 0, white);
+    try expectFrame(&reference, &drawn(&list));
+}
+
+test "lines match Bresenham, however far out their ends are" {
+    const ends = [_][2][3]i32{
+        .{ .{ 0, 0, 0 }, .{ 7, 7, 7 } },
+        .{ .{ 7, 1, 0 }, .{ 0, 4, 6 } },
+        .{ .{ 3, 3, 3 }, .{ 3, 3, 3 } },
+        .{ .{ -5, 2, 9 }, .{ 12, 6, -3 } },
+        .{ .{ -20, -3, 4 }, .{ 40, 11, 4 } },
+        .{ .{ 2, -100, 1 }, .{ 5, 100, 6 } },
+        // Would have turned into a different line if the ends got clipped to a small range
+        .{ .{ -1000, 3, 0 }, .{ 1000, 4, 7 } },
+        .{ .{ 2_000_000_000, 1, 2 }, .{ -2_000_000_000, 6, 5 } },
+        // Misses the cube
+        .{ .{ -3, 9, 0 }, .{ 12, 9, 7 } },
+    };
+    for (ends) |e| {
+        var list: DrawList = .{};
+        try std.testing.expect(list.line(e[0][0], e[0][1], e[0][2], e[1][0], e[1][1], e[1][2], white));
+        var reference: FrameBuffer = .{};
+        if (@abs(e[0][0]) < 10_000) {
+            referenceLine(&reference, e[0], e[1], white);
+        } else {
+            // Too long to walk one voxel at a time. Halfway along, y and z have moved 2 and 1,
+            // and they stay there all the way across the cube
+            referenceLine(&reference, .{ 7, 3, 3 }, .{ 0, 3, 3 }, white);
+        }
+        try expectFrame(&reference, &drawn(&list));
+    }
+}
+
+test "spheres keep their centre and radius, even off the cube" {
+    const spheres = [_][4]i32{
+        .{ 3, 4, 4, 2 },
+        .{ 0, 0, 0, 3 },
+        .{ 10, 4, 4, 4 },
+        .{ 20, 4, 4, 15 },
+        .{ -15, 3, 3, 15 },
+        // Too big or too far out for a Command, so they go in as blits
+        .{ -100, 3, 3, 103 },
+        .{ 3, 4, 1000, 995 },
+        .{ 4, 4, 4, 40 },
+        .{ 2_000_000_000, 3, 3, 1_999_999_996 },
+    };
+    for (spheres) |sp| {
+        var list: DrawList = .{};
+        try std.testing.expect(list.sphere(sp[0], sp[1], sp[2], sp[3], white));
+        try std.testing.expect(list.len > 0);
+        var reference: FrameBuffer = .{};
+        for (0..8) |x| {
+            for (0..8) |y| {
+                for (0..8) |z| {
+                    const dx = @as(i128, @intCast(x)) - sp[0];
+                    const dy = @as(i128, @intCast(y)) - sp[1];
+                    const dz = @as(i128, @intCast(z)) - sp[2];
+                    // Within radius + 0.5, times 4 to stay in integers
+                    if (4 * (dx * dx + dy * dy + dz * dz) <= (2 * @as(i128, sp[3]) + 1) * (2 * @as(i128, sp[3]) + 1)) {
+                        reference.set_pixel(@intCast(x), @intCast(y), @intCast(z), white);
+                    }
+                }
+            }
+        }
+        try expectFrame(&reference, &drawn(&list));
+    }
+    // Nothing to draw, so nothing gets added. The last one is within reach along every axis, but not of the corner
+    for ([_][4]i32{ .{ 40, 4, 4, 15 }, .{ -2_000_000_000, 3, 3, 1_000_000_000 }, .{ -10, -10, -10, 16 } }) |sp| {
+        var list: DrawList = .{};
+        try std.testing.expect(list.sphere(sp[0], sp[1], sp[2], sp[3], white));
+        try std.testing.expectEqual(@as(usize, 0), list.len);
+    }
+}
+
+test "spans along every axis, clipped at the edges" {
+    var list: DrawList = .{};
+    _ = list.span(-2, 1, 1, .x, 5, white);
+    _ = list.span(6, 5, 2, .y, 8, white);
+    _ = list.span(4, 4, 5, .z, 8, white);
+    // Starts far off the cube and runs back onto it
+    _ = list.span(-12, 3, 3, .x, 16, white);
+    _ = list.span(7, -2_000_000_000, 6, .y, 2_000_000_002, white);
+    // Off the cube the other way, or going nowhere
+    _ = list.span(3, 9, 3, .x, 8, white);
+    _ = list.span(3, 3, 3, .z, -4, white);
+    try std.testing.expectEqual(@as(usize, 5), list.len);
+    var reference: FrameBuffer = .{};
+    for (0..4) |x| {
+        reference.set_pixel(@intCast(x), 3, 3, white);
+    }
+    for (0..2) |y| {
+        reference.set_pixel(7, @intCast(y), 6, white);
+    }
+    for (0..3) |x| {
+        reference.set_pixel(@intCast(x), 1, 1, white);
+    }
+    for (5..8) |y| {
+        reference.set_pixel(6, @intCast(y), 2, white);
+    }
+    for (5..8) |z| {
+        reference.set_pixel(4, 4, @intCast(z), white);
+    }
+    try expectFrame(&reference, &drawn(&list));
+}
+
+test "clear fills everything, later commands draw over earlier ones" {
+    const red = Led{ .r = 1, .g = 0, .b = 0 };
+    const off = Led{ .r = 0, .g = 0, .b = 0 };
+    var list: DrawList = .{};
+    _ = list.voxel(2, 2, 2, white);
+    _ = list.clear(red);
+    _ = list.voxel(5, 6, 7, off);
+    var reference: FrameBuffer = .{};
+    for (0..8) |x| {
+        for (0..8) |y| {
+            for (0..8) |z| {
+                reference.set_pixel(@intCast(x), @intCast(y), @intCast(z), red);
+            }
+        }
+    }
+    reference.set_pixel(5, 6, 7, off);
+    try expectFrame(&reference, &drawn(&list));
+}
+
+test "a full list drops and counts the rest" {
+    var list: DrawList = .{};
+    for (0..capacity) |_| {
+        try std.testing.expect(list.voxel(0, 0, 0, white));
+    }
+    try std.testing.expect(!list.clear(white));
+    try std.testing.expectEqual(@as(u32, 1), list.dropped);
+    list.reset();
+    try std.testing.expect(list.len == 0 and list.dropped == 0);
+}
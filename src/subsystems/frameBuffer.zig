@@ -0,0 +1,155 @@
+/// frameBuffer.zig
+/// The packed frame the shift registers get fed, and the helpers for poking at it.
+/// Only depends on std, so everything that just draws into frames (compositor, orientation, ...) can be tested on the host.
+/// matrix.zig re-exports all of it.
+const std = @import("std");
+
+pub const Led = packed struct {
+    r: u1,
+    g: u1,
+    b: u1,
+};
+
+pub const Color = enum { R, G, B };
+
+/// Bit 0 of every voxel in a packed row. Multiply by a raw Led to fill a row with it
+pub const row_voxel_lsbs: u32 = 0x249249;
+
+pub fn rowPattern(color: Led) u32 {
+    return row_voxel_lsbs * @as(u32, @as(u3, @bitCast(color)));
+}
+
+pub const LayerData = extern struct {
+    layerId: u8,
+    srs: [24]u8 = .{0} ** 24,
+
+    /// Row-wide access to the packed data, for code that wants to skip set_pixel.
+    /// A row is 24 bits, voxel i sits in bits 3i..3i+2 (r, g, b).
+    /// Row r holds x = 7 - r, and voxel i in it holds y = 7 - i (same mapping as FrameBuffer.set_pixel)
+    pub fn getRow(self: *const LayerData, row: u3) u32 {
+        const bytes = self.srs[@as(usize, row) * 3 ..][0..3];
+        return @as(u32, bytes[0]) | (@as(u32, bytes[1]) << 8) | (@as(u32, bytes[2]) << 16);
+    }
+
+    pub fn setRow(self: *LayerData, row: u3, bits: u32) void {
+        const bytes = self.srs[@as(usize, row) * 3 ..][0..3];
+        bytes[0] = @truncate(bits);
+        bytes[1] = @truncate(bits >> 8);
+        bytes[2] = @truncate(bits >> 16);
+    }
+
+    /// Replaces only the bits under mask
+    pub fn writeRow(self: *LayerData, row: u3, mask: u32, bits: u32) void {
+        self.setRow(row, (self.getRow(row) & ~mask) | (bits & mask));
+    }
+};
+
+pub const FrameBuffer = extern struct {
+    layers: [8]LayerData = defaultLayers: {
+        var layers: [8]LayerData = .{LayerData{ .layerId = 0 }} ** 8;
+        for (0..8) |i| {
+            layers[7 - i].layerId = i; // NOTE: hardware inverted z
+
+        }
+        break :defaultLayers layers;
+    },
+
+    /// Right-handed coordinates where z is up
+    pub fn set_pixel(self: *FrameBuffer, x_: i32, y_: i32, z: i32, color: Led) void {
+        const x = 7 - y_;
+        const y = x_;
+        const layer: *LayerData = &self.layers[@intCast(z)];
+        const newY: i32 = 7 - y;
+        const offset: i32 = 3 * newY;
+        const row: []u8 = layer.srs[@intCast(offset)..];
+        const rawColor: u8 = @intCast(@as(u3, @bitCast(color)));
+        switch (x) {
+            0 => {
+                row[0] &= ~@as(u8, 0x7);
+                row[0] |= rawColor;
+            },
+            1 => {
+                row[0] &= ~@as(u8, 0x38);
+                row[0] |= rawColor << 3;
+            },
+            2 => {
+                row[0] &= ~@as(u8, 0xC0);
+                row[0] |= rawColor << 6;
+                row[1] &= ~@as(u8, 0x1);
+                row[1] |= rawColor >> 2;
+            },
+            3 => {
+                row[1] &= ~@as(u8, 0x0e);
+                row[1] |= rawColor << 1;
+            },
+            4 => {
+                row[1] &= ~@as(u8, 0x70);
+                row[1] |= rawColor << 4;
+            },
+            5 => {
+                row[1] &= ~@as(u8, 0x80);
+                row[1] |= rawColor << 7;
+                row[2] &= ~@as(u8, 0x03);
+                row[2] |= rawColor >> 1;
+            },
+            6 => {
+                row[2] &= ~@as(u8, 0x1c);
+                row[2] |= rawColor << 2;
+            },
+            7 => {
+                row[2] &= ~@as(u8, 0xe0);
+                row[2] |= rawColor << 5;
+            },
+            else => {},
+        }
+    }
+
+    /// Every voxel to color, what matrix.clearFrame() does to the draw buffer
+    pub fn clear(self: *FrameBuffer, color: Led) void {
+        for (0..8) |x| {
+            for (0..8) |y| {
+                for (0..8) |z| {
+                    self.set_pixel(@intCast(x), @intCast(y), @intCast(z), color);
+                }
+            }
+        }
+    }
+
+    pub fn set_channel(self: *FrameBuffer, x: u3, y: u3, z: u3, channel: Color, val: u1) void {
+        const bitoffset: u8 = (x * 3 + @intFromEnum(channel));
+        const srptr: *u8 = &self.layers[z].srs[bitoffset / 8 + (3 * (7 - y))];
+
+        srptr.* &= ~(@as(u8, 1) << @intCast(bitoffset % 8));
+        srptr.* |= (@as(u8, val) << @intCast(bitoffset % 8));
+    }
+};
+
+// Number of BAM planes we keep buffers for. Scan profiles can choose to show fewer of them
+pub const BAM_bits = 5;
+
+pub const BAM_int = std.meta.Int(.unsigned, BAM_bits);
+
+pub const BAM_color = struct {
+    r: BAM_int,
+    g: BAM_int,
+    b: BAM_int,
+};
+
+comptime {
+    // Assert that our layers have the correct memory map
+    std.debug.assert(@import("builtin").target.cpu.arch.endian() == std.builtin.Endian.little);
+    std.debug.assert(@sizeOf(LayerData) == 25);
+    std.debug.assert(@offsetOf(LayerData, "layerId") == 0);
+    std.debug.assert(@offsetOf(LayerData, "srs") == 1);
+    // Assert that our frames have the correct memory map
+    std.debug.assert(@sizeOf(FrameBuffer) == 25 * 8);
+}
+
+test "row helpers agree with set_pixel" {
+    var frame: FrameBuffer = .{};
+    frame.set_pixel(2, 6, 3, .{ .r = 1, .g = 0, .b = 1 });
+    // x = 2 -> row 5, y = 6 -> voxel 1
+    try std.testing.expectEqual(@as(u32, 0b101 << 3), frame.layers[3].getRow(5));
+    frame.layers[3].writeRow(5, 0b111 << 3, rowPattern(.{ .r = 0, .g = 1, .b = 0 }));
+    try std.testing.expectEqual(@as(u32, 0b010 << 3), frame.layers[3].getRow(5));
+}
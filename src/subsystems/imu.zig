@@ -10,6 +10,7 @@ const RCC = peripherals.RCC;
 const UartDebug = @import("../util/uartDebug.zig");
 const DeltaTime = @import("deltaTime.zig");
 const fp = @import("../util/fixedPoint.zig");
+const Trace = @import("../util/trace.zig");
 
 pub const AngleFpInt = fp.FixedPoint(16, 16, .signed);
 pub const AccelFpInt = fp.FixedPoint(8, 24, .signed);
@@ -60,6 +61,7 @@ pub fn updateInstantaneousVals() void {
 
     var readingData: [BYTES_PER_READING]u8 = undefined;
     burstReadICM(0x3B, &readingData);
+    Trace.imu(&readingData);
 
     accel.x = ACCEL_LSB_TO_G.mul(asI16(readingData[0..2]));
     accel.y = ACCEL_LSB_TO_G.mul(asI16(readingData[2..4]));
@@ -70,29 +72,44 @@ pub fn updateInstantaneousVals() void {
     gyro.z = ANGLE_LSB_TO_DPS.mul(asI16(readingData[12..14]));
 }
 
+/// Raw accelerometer counts (16384 = 1 g), without touching what getAccel() returns.
+/// Goes through Trace like updateInstantaneousVals(), so only call it from the app's own loop.
+pub fn readGravity() [3]i16 {
+    var data: [6]u8 = undefined;
+    burstReadICM(0x3B, &data);
+    Trace.imu(&data);
+    return .{ asI16(data[0..2]), asI16(data[2..4]), asI16(data[4..6]) };
+}
+
 /// Updates both instantaneous values and orientation.
 /// They can be accessed via getAccel(), getGyro(), and getOrientation()
 /// This calls updateInstantaneousVals(), so do not call both
 pub fn updateOrientation() void {
     updateInstantaneousVals();
-    const milis = dt.milli();
+    orientation = fuse(orientation, gyro, accel, dt.milli());
+
+    UartDebug.printIfDebug("Ornt: ", .{}) catch {};
+    orientation.prettyPrint(UartDebug.writer, 5) catch {};
+}
+
+/// One step of the filter, without any I/O. Integrates gyro over milis, then pulls towards accel's gravity
+pub fn fuse(prev: AngleRotor, gyroNow: AngleVec, accelNow: AccelVec, milis: u32) AngleRotor {
     const sec = (AngleFpInt{ .fp = .{ .integer = @intCast(milis), .fraction = 0 } }).div(1000);
 
     // Quaternion derivative stuff
     // See: https://ahrs.readthedocs.io/en/latest/filters/angular.html#main-content
     // And: https://jacquesheunis.com/post/rotors/#how-do-i-turn-a-quaternion-into-an-equivalent-3d-rotor
     const deltaOrientation = (AngleRotor{
-        .scalar = gyro.x.mul(-1).mul(orientation.yz).sub(gyro.y.mul(orientation.zx)).sub(gyro.z.mul(orientation.xy)),
-        .yz = gyro.x.mul(orientation.scalar).add(gyro.z.mul(orientation.zx)).sub(gyro.y.mul(orientation.xy)),
-        .zx = gyro.y.mul(orientation.scalar).sub(gyro.z.mul(orientation.yz)).add(gyro.x.mul(orientation.xy)),
-        .xy = gyro.z.mul(orientation.scalar).add(gyro.y.mul(orientation.yz)).sub(gyro.x.mul(orientation.zx)),
+        .scalar = gyroNow.x.mul(-1).mul(prev.yz).sub(gyroNow.y.mul(prev.zx)).sub(gyroNow.z.mul(prev.xy)),
+        .yz = gyroNow.x.mul(prev.scalar).add(gyroNow.z.mul(prev.zx)).sub(gyroNow.y.mul(prev.xy)),
+        .zx = gyroNow.y.mul(prev.scalar).sub(gyroNow.z.mul(prev.yz)).add(gyroNow.x.mul(prev.xy)),
+        .xy = gyroNow.z.mul(prev.scalar).add(gyroNow.y.mul(prev.yz)).sub(gyroNow.x.mul(prev.zx)),
     }).mul(sec.div(2));
 
-    const predictedOrientation = orientation.add(deltaOrientation).norm();
-    orientation = predictedOrientation;
+    const predictedOrientation = prev.add(deltaOrientation).norm();
 
     // Predicted gravity
-    const predGrav = predictedOrientation.rotateVector(accel);
+    const predGrav = predictedOrientation.rotateVector(accelNow);
 
     var accelCorrection = if (predGrav.z.fp.integer < 0) unreachable // AngleRotor{
     else AngleRotor{
@@ -104,10 +121,7 @@ pub fn updateOrientation() void {
     accelCorrection = accelCorrection.norm();
     accelCorrection = accelCorrection.slerpI(alpha);
 
-    orientation = accelCorrection.mulRotor(predictedOrientation).norm();
-
-    UartDebug.printIfDebug("Ornt: ", .{}) catch {};
-    orientation.prettyPrint(UartDebug.writer, 5) catch {};
+    return accelCorrection.mulRotor(predictedOrientation).norm();
 }
 
 pub fn restartOrientation() void {
@@ -135,6 +149,15 @@ pub fn getZeroedOrientation() AngleRotor {
 }
 
 pub fn init() void {
+    startInit();
+    // 2 ms startup time
+    c.nano_wait(2_000_000);
+    while (!pollReset()) {}
+}
+
+/// First half of init(): bus setup, then starts the ICM reset.
+/// Give it 2 ms, then call pollReset() until it returns true. Used by the boot sequence
+pub fn startInit() void {
     RCC.AHBENR.modify(.{
         .GPIOAEN = 1,
     });
@@ -189,7 +212,7 @@ pub fn init() void {
     const whoami = readICM(0x75);
     std.debug.assert(whoami == 0x11);
 
-    resetICM();
+    startReset();
 }
 
 fn asI16(data: *[2]u8) i16 {
@@ -212,13 +235,26 @@ fn readU16(startAddr: u8) u16 {
 
 // Resets and configures our desired settings
 pub fn resetICM() void {
-    // Reset
-    writeICM(0x6B, 1 << 7);
-
-    // Wait for reset bit to clear
+    startReset();
     // 2 ms startup time
     c.nano_wait(2_000_000);
-    while ((readICM(0x6B) & (1 << 7)) > 0) {}
+    while (!pollReset()) {}
+}
+
+fn startReset() void {
+    writeICM(0x6B, 1 << 7);
+}
+
+/// Configures the ICM once it's out of reset. Returns false while the reset bit is still set
+pub fn pollReset() bool {
+    if ((readICM(0x6B) & (1 << 7)) > 0) {
+        return false;
+    }
+    configure();
+    return true;
+}
+
+fn configure() void {
     // Burst write our config
     const smplrt_div: u8 = (1000 / SAMPLE_RATE) - 1;
     // DLPF set to 5 hz
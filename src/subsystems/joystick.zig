@@ -3,6 +3,8 @@ const std = @import("std");
 const cImport = @import("../cImport.zig");
 const apps = @import("../main.zig").apps;
 const deltaT = @import("./deltaTime.zig");
+const Trace = @import("../util/trace.zig");
+const Latency = @import("../util/latency.zig");
 
 var prev_button_pressed = false;
 var cur_button_pressed = false;
@@ -39,7 +41,8 @@ pub fn button_pressed() callconv(.C) bool {
     }
     prev_button_pressed = cur_button_pressed;
 
-    return (dummy_cur and !dummy_prev);
+    const edge = Trace.input(.joystick_button, dummy_cur and !dummy_prev);
+    return Latency.tracker.consume(.joystick_button, edge, deltaT.millis());
 }
 
 pub fn moved_up() callconv(.C) bool {
@@ -51,7 +54,8 @@ pub fn moved_up() callconv(.C) bool {
     }
     prev_up = cur_up;
 
-    return (dummy_cur and !dummy_prev);
+    const edge = Trace.input(.joystick_up, dummy_cur and !dummy_prev);
+    return Latency.tracker.consume(.joystick_up, edge, deltaT.millis());
 }
 
 pub fn moved_down() callconv(.C) bool {
@@ -63,7 +67,8 @@ pub fn moved_down() callconv(.C) bool {
     }
     prev_down = cur_down;
 
-    return (dummy_cur and !dummy_prev);
+    const edge = Trace.input(.joystick_down, dummy_cur and !dummy_prev);
+    return Latency.tracker.consume(.joystick_down, edge, deltaT.millis());
 }
 
 pub fn moved_right() callconv(.C) bool {
@@ -75,7 +80,8 @@ pub fn moved_right() callconv(.C) bool {
     }
     prev_right = cur_right;
 
-    return (dummy_cur and !dummy_prev);
+    const edge = Trace.input(.joystick_right, dummy_cur and !dummy_prev);
+    return Latency.tracker.consume(.joystick_right, edge, deltaT.millis());
 }
 
 pub fn moved_left() callconv(.C) bool {
@@ -87,7 +93,8 @@ pub fn moved_left() callconv(.C) bool {
     }
     prev_left = cur_left;
 
-    return (dummy_cur and !dummy_prev);
+    const edge = Trace.input(.joystick_left, dummy_cur and !dummy_prev);
+    return Latency.tracker.consume(.joystick_left, edge, deltaT.millis());
 }
 
 // memory byte handling
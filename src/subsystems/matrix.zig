@@ -6,9 +6,17 @@
 ///     pin A0 & A1 for SCLK input & LE respectively
 const microzig = @import("microzig");
 const std = @import("std");
+const buildMode = @import("builtin").mode;
 const math = std.math;
 const cImport = @import("../cImport.zig");
 const UartdDebug = @import("../util/uartDebug.zig");
+const Trace = @import("../util/trace.zig");
+const Orientation = @import("orientation.zig");
+const cycles = @import("../util/cycles.zig");
+const Latency = @import("../util/latency.zig");
+const BamJitter = @import("../util/bamJitter.zig");
+const deltaTime = @import("deltaTime.zig");
+const FrameBufferTypes = @import("frameBuffer.zig");
 const cmsis = cImport.cmsis;
 const peripherals = microzig.chip.peripherals;
 const periph_types = microzig.chip.types.peripherals;
@@ -25,36 +33,197 @@ const TIM15 = peripherals.TIM15;
 pub const upperBound: comptime_int = 7;
 pub const lowerBound: comptime_int = 0;
 
-pub const BAM_bits = 3;
-// Max time that it should take to do every BAM phase (MSB, ..., LSB)
-// Sum of time spent on all bits will be about equal to this, but stuff can go wrong so build in some safety here.
-pub const BAM_max_time: comptime_float = 1.0 / 80.0;
-pub const BAM_lsb_time = BAM_max_time / @as(comptime_float, (1 << BAM_bits - 1.0));
-pub const BAM_lsb_time_us: usize = @floor(BAM_lsb_time * 1_000_000);
+pub const BAM_bits = FrameBufferTypes.BAM_bits;
+
+// ------------------------
+// Refresh budget & profiles
+// ------------------------
+const BR = periph_types.spi_v2.BR;
+pub const sysclock_hz: comptime_int = 48_000_000;
+// Every LSB slot needs at least one full scan of the frame, plus a safety factor of 10%
+const shift_margin: comptime_float = 1.1;
+
+/// What a given SPI divisor and plane count costs us
+pub const RefreshBudget = struct {
+    divisor: BR,
+    planes: u8,
+    /// Time to shift the whole FrameBuffer out once. This is one pass over all 8 layers
+    shift_time_us: f32,
+    /// Length of the shortest BAM plane. Plane i is shown for lsb_time_us << i
+    lsb_time_us: u32,
+    /// Whole BAM cycles (all planes) per second
+    refresh_hz: f32,
+    /// Fraction of the LSB slot spent on complete scans.
+    /// The leftover partial scan lights some layers longer than others, so lower is less uniform
+    efficiency: f32,
+    /// LSB slot fits a full scan with margin, and the MSB slot fits in TIM15's 16 bit ARR
+    feasible: bool,
+};
+
+pub fn divisorValue(divisor: BR) u32 {
+    return @as(u32, 2) << @intFromEnum(divisor);
+}
+
+/// Works out the timing for showing `planes` BAM planes `refresh_hz` times a second at SCLK = sysclock / divisor.
+/// Meant for comptime, but it's plain float math so it works on the host or over uart as well.
+pub fn refreshBudget(divisor: BR, planes: u8, refresh_hz: f32) RefreshBudget {
+    std.debug.assert(planes >= 1 and planes <= 16);
+    const sclk: f32 = @floatFromInt(sysclock_hz / divisorValue(divisor));
+    const shift_us: f32 = @sizeOf(FrameBuffer) * 8 * 1_000_000.0 / sclk;
+    const slots: f32 = @floatFromInt((@as(u32, 1) << @intCast(planes)) - 1);
+    const lsb_us: u32 = @intFromFloat(@floor(1_000_000.0 / (refresh_hz * slots)));
+    const lsb: f32 = @floatFromInt(lsb_us);
+    const msb_us = @as(u64, lsb_us) << @intCast(planes - 1);
+    return .{
+        .divisor = divisor,
+        .planes = planes,
+        .shift_time_us = shift_us,
+        .lsb_time_us = lsb_us,
+        .refresh_hz = if (lsb_us == 0) 0 else 1_000_000.0 / (lsb * slots),
+        .efficiency = if (lsb_us == 0) 0 else @floor(lsb / shift_us) * shift_us / lsb,
+        .feasible = lsb > shift_us * shift_margin and msb_us <= math.maxInt(u16),
+    };
+}
+
+/// Budget for every SPI divisor (rows, .Div2 first) and plane count (columns, 1 plane first)
+pub fn budgetTable(refresh_hz: f32) [8][BAM_bits]RefreshBudget {
+    var table: [8][BAM_bits]RefreshBudget = undefined;
+    for (0..8) |d| {
+        for (0..BAM_bits) |p| {
+            table[d][p] = refreshBudget(@enumFromInt(d), @intCast(p + 1), refresh_hz);
+        }
+    }
+    return table;
+}
+
+pub fn printBudgetTable(writer: anytype, refresh_hz: f32) !void {
+    try writer.print("Refresh budget at {d:.0} Hz ({} byte frame)\n", .{ refresh_hz, @sizeOf(FrameBuffer) });
+    for (budgetTable(refresh_hz)) |row| {
+        for (row) |b| {
+            try writer.print("/{: <3} planes: {}  shift: {d:.1} us  lsb: {} us  refresh: {d:.1} Hz  efficiency: {d:.2}{s}\n", .{
+                divisorValue(b.divisor),
+                b.planes,
+                b.shift_time_us,
+                b.lsb_time_us,
+                b.refresh_hz,
+                b.efficiency,
+                if (b.feasible) "" else "  (infeasible)",
+            });
+        }
+    }
+}
+
+/// A comptime-checked SPI divisor + BAM depth + refresh rate that the driver can switch between at runtime.
+/// Profiles with fewer planes than BAM_bits show the most significant ones,
+/// so BAM_color values keep the same meaning in every profile.
+pub const ScanProfile = struct {
+    name: []const u8,
+    divisor: BR,
+    planes: u8,
+    lsb_time_us: u16,
+
+    pub fn init(comptime name: []const u8, comptime divisor: BR, comptime planes: u8, comptime refresh_hz: f32) ScanProfile {
+        if (planes < 1 or planes > BAM_bits) {
+            @compileError(std.fmt.comptimePrint("Scan profile \"{s}\" needs between 1 and BAM_bits ({}) planes", .{ name, BAM_bits }));
+        }
+        const budget = comptime refreshBudget(divisor, planes, refresh_hz);
+        if (!budget.feasible) {
+            @compileError(std.fmt.comptimePrint("Scan profile \"{s}\" can't shift a full frame in its {} us LSB slot, or overflows TIM15", .{ name, budget.lsb_time_us }));
+        }
+        return .{
+            .name = name,
+            .divisor = divisor,
+            .planes = planes,
+            .lsb_time_us = budget.lsb_time_us,
+        };
+    }
+
+    /// Index of the first (least significant) plane this profile shows
+    pub fn firstPlane(self: *const ScanProfile) BamBitInd {
+        return @intCast(BAM_bits - self.planes);
+    }
+};
+
+pub const profiles = struct {
+    /// Plain 1 bit colour. The ISR just relatches the MSB plane
+    pub const high_refresh_1bit = ScanProfile.init("High refresh 1-bit", .Div4, 1, 1000);
+    pub const bam8_80hz = ScanProfile.init("8-level BAM @ 80 Hz", .Div4, 3, 80);
+    pub const bam32_60hz = ScanProfile.init("32-level BAM @ 60 Hz", .Div4, 5, 60);
+    /// For startStreaming. 200 bits at 750 kHz gives the producer ~267 us (~12800 cycles) per layer,
+    /// and the cube still refreshes at ~470 Hz
+    pub const streaming = ScanProfile.init("Layer streaming", .Div64, 1, 400);
+};
+
+var activeProfile: *const ScanProfile = &profiles.bam8_80hz;
+
 comptime {
-    // Time to shift out stuff + a safety factor of 10%
-    std.debug.assert(BAM_lsb_time > (1.0 / 4_000_000.0) * 200 * 1.1);
-    std.debug.assert(BAM_lsb_time_us << (BAM_bits - 1) <= math.maxInt(u16));
+    @setEvalBranchQuota(10_000);
+    // 200 bytes at 48 / 4 MHz
+    const div4 = refreshBudget(.Div4, 3, 80);
+    std.debug.assert(@round(div4.shift_time_us * 100) == 13333);
+    // 12.5 ms over 7 LSB slots
+    std.debug.assert(div4.lsb_time_us == 1785);
+    std.debug.assert(div4.refresh_hz >= 80 and div4.refresh_hz < 80.1);
+    std.debug.assert(div4.efficiency > 0.95 and div4.efficiency <= 1);
+    std.debug.assert(div4.feasible);
+    // Slow SCLK can't fit a frame into a deep LSB
+    std.debug.assert(!refreshBudget(.Div256, BAM_bits, 60).feasible);
+    // Long MSB overflows TIM15
+    std.debug.assert(!refreshBudget(.Div4, 8, 1).feasible);
+    // Fastest clock can always do at least the 1 plane at 80 Hz
+    std.debug.assert(budgetTable(80)[0][0].feasible);
 }
 
 // Frame buffers for rendering
 var frameBuff1: FrameBuffer = .{};
 var frameBuff2: FrameBuffer = .{};
 var drawBuff: *FrameBuffer = &frameBuff1; // buffer that isn't currently being rendered
+// What DMA is actually reading. The other frame buffer, or its turned copy from orientation.zig
+var shiftBuff: *const FrameBuffer = &frameBuff2;
 
 pub export fn IRQ_DMA1_Ch4_7_DMA2_Ch3_5() callconv(.C) void {
+    const flags = DMA2.ISR.read();
     DMA2.IFCR.modify(.{
         // NOTE: Same bug here. Gotta use 3 instead of 4 cuz microzig has 0
         .@"TCIF[3]" = 1,
+        .@"HTIF[3]" = 1,
+    });
+    if (streamRunning) {
+        stream.dmaEvent(flags.@"HTIF[3]" == 1, flags.@"TCIF[3]" == 1);
+    } else if (scanStamp) |stamp| {
+        // First pass over the new frame is done, nothing else needs this interrupt until the next one
+        cmsis.NVIC.*.ICER[0] = @as(u32, 1 << cmsis.DMA1_Ch4_7_DMA2_Ch3_5_IRQn);
+        scanStamp = null;
+        Latency.tracker.shown(stamp, deltaTime.millis());
+    }
+}
+
+/// Input the frame DMA just started on consumed. Set while waiting for its first transfer complete
+var scanStamp: ?Latency.FrameStamp = null;
+
+/// Call right after DMA starts on a new frame. The DMA interrupt is only on while there's a stamp waiting,
+/// so frames without input cost nothing. A frame replaced before it finished a scan drops its stamp
+fn stampOnScanEnd(stamp: ?Latency.FrameStamp) void {
+    const s = stamp orelse return;
+    // Off while scanStamp is written, it might still be on for the frame before
+    cmsis.NVIC.*.ICER[0] = @as(u32, 1 << cmsis.DMA1_Ch4_7_DMA2_Ch3_5_IRQn);
+    // TCIF is still set from the last frame's passes. A pass takes far longer than getting here
+    DMA2.IFCR.modify(.{
+        .@"TCIF[3]" = 1,
+        .@"HTIF[3]" = 1,
     });
+    cmsis.NVIC.*.ICPR[0] = @as(u32, 1 << cmsis.DMA1_Ch4_7_DMA2_Ch3_5_IRQn);
+    scanStamp = s;
+    cmsis.NVIC.*.ISER[0] = @as(u32, 1 << cmsis.DMA1_Ch4_7_DMA2_Ch3_5_IRQn);
 }
 
 /// Setup the display
 /// Params:
-///     sysclock_divisor: an enum of the form .Div2 to .Div256 (powers of 2)
-///         default should be .Div4
-///         SCLK will have a frequency of sysclock (48 Mhz) divided by this number
-pub fn init(sysclock_divisor: periph_types.spi_v2.BR) void {
+///     profile: the scan profile to start with. Default should be &profiles.bam8_80hz
+///         SCLK will have a frequency of sysclock (48 Mhz) divided by profile.divisor
+///         Can be changed later with requestProfile()
+pub fn init(profile: *const ScanProfile) void {
+    activeProfile = profile;
     const num_srs = 25;
     const bit_count = num_srs * 8;
     // Enable clocks
@@ -105,7 +274,7 @@ pub fn init(sysclock_divisor: periph_types.spi_v2.BR) void {
         .CPHA = .FirstEdge,
         .CPOL = .IdleLow,
         .MSTR = .Master,
-        .BR = sysclock_divisor,
+        .BR = profile.divisor,
         .LSBFIRST = .MSBFirst,
     });
     SPI1.CR2.modify(.{
@@ -192,18 +361,16 @@ pub fn init(sysclock_divisor: periph_types.spi_v2.BR) void {
 /// Data must remain a valid pointer for the durration of the shift, as DMA will read from it
 pub fn startShift(data: *const FrameBuffer) void {
     comptime std.debug.assert(@sizeOf(FrameBuffer) == (25 * 8));
-    DMA2_CH4.CR.modify(.{
-        .EN = 0,
-    });
-    TIM2.CR1.modify(.{
-        .CEN = 0,
-    });
-    // Wait for SPI to finish
-    while (SPI1.SR.read().BSY == 1) {}
+    startDma(std.mem.asBytes(data));
+}
+
+/// Streams data over and over. Has to be a whole number of layers so LE lines up
+fn startDma(data: []const u8) void {
+    stopShift();
 
-    DMA2_CH4.MAR = @intFromPtr(data);
+    DMA2_CH4.MAR = @intFromPtr(data.ptr);
     DMA2_CH4.NDTR.modify(.{
-        .NDT = @sizeOf(FrameBuffer),
+        .NDT = @intCast(data.len),
     });
     TIM2.CNT = 0;
     TIM2.CR1.modify(.{
@@ -215,112 +382,156 @@ pub fn startShift(data: *const FrameBuffer) void {
     });
 }
 
-fn getDmaCh(dma: *volatile periph_types.bdma_v2.DMA, channel: comptime_int) *periph_types.bdma_v2.CH {
-    return @ptrFromInt(@intFromPtr(&dma.CH) + 20 * (channel - 1));
+/// Stops DMA and the latch timer, then waits for the last byte to leave SPI1
+fn stopShift() void {
+    DMA2_CH4.CR.modify(.{
+        .EN = 0,
+    });
+    TIM2.CR1.modify(.{
+        .CEN = 0,
+    });
+    // Wait for SPI to finish
+    while (SPI1.SR.read().BSY == 1) {}
 }
 
-pub const Led = packed struct {
-    r: u1,
-    g: u1,
-    b: u1,
-};
+/// BR can only change while SPI1 is disabled, so nothing can be shifting when this is called
+fn applyProfile(profile: *const ScanProfile) void {
+    SPI1.CR1.modify(.{
+        .SPE = 0,
+    });
+    SPI1.CR1.modify(.{
+        .BR = profile.divisor,
+    });
+    SPI1.CR1.modify(.{
+        .SPE = 1,
+    });
+    activeProfile = profile;
+}
 
-const Color = enum { R, G, B };
+/// Switches SPI1/TIM15 over to a new scan profile.
+/// With BAM running the switch happens in TIM15_IRQ at the end of a BAM cycle, and this blocks until it has.
+/// Otherwise the frame being shown is restarted at the new SCLK right away.
+/// While layers are streaming the switch waits for stopStreaming(), restarting the shift would tear the ring.
+pub fn requestProfile(profile: *const ScanProfile) void {
+    if (streamRunning) {
+        streamPrevProfile = profile;
+    } else if (BAM_running) {
+        BAM_profilePending.* = profile;
+        while (BAM_profilePending.* != null) {
+            asm volatile ("nop");
+        }
+    } else {
+        stopShift();
+        applyProfile(profile);
+        startShift(shiftBuff);
+    }
+}
 
-pub const LayerData = extern struct {
-    layerId: u8,
-    srs: [24]u8 = .{0} ** 24,
-};
+pub fn getProfile() *const ScanProfile {
+    return activeProfile;
+}
 
-pub const FrameBuffer = extern struct {
-    layers: [8]LayerData = defaultLayers: {
-        var layers: [8]LayerData = .{LayerData{ .layerId = 0 }} ** 8;
-        for (0..8) |i| {
-            layers[7 - i].layerId = i; // NOTE: hardware inverted z
+// ----------------
+// Layer streaming
+// ----------------
+
+const LayerRing = @import("../util/layerRing.zig").LayerRing(LayerData);
+pub const LayerProducer = LayerRing.Producer;
+
+var stream: LayerRing = .{ .producer = undefined };
+var streamRunning = false;
+var streamPrevProfile: *const ScanProfile = &profiles.bam8_80hz;
+
+/// Shows the cube without a frame buffer: producer gets called from the DMA interrupt for each layer
+/// right before it shifts out, while the layer before it is on its way out.
+/// Each call has one layer time to finish (see profiles.streaming). render() does nothing until stopStreaming().
+/// BAM has to be off
+pub fn startStreaming(producer: LayerProducer, profile: *const ScanProfile) void {
+    std.debug.assert(!BAM_running and !streamRunning);
+    stopShift();
+    streamPrevProfile = activeProfile;
+    applyProfile(profile);
+    scanStamp = null;
+
+    stream = .{ .producer = producer };
+    stream.prime();
+    DMA2.IFCR.modify(.{
+        .@"TCIF[3]" = 1,
+        .@"HTIF[3]" = 1,
+    });
+    DMA2_CH4.CR.modify(.{
+        .HTIE = 1,
+        .TCIE = 1,
+    });
+    streamRunning = true;
+    cmsis.NVIC.*.ISER[0] |= @as(u32, 1 << cmsis.DMA1_Ch4_7_DMA2_Ch3_5_IRQn);
+    startDma(std.mem.asBytes(&stream.slots));
+}
 
-        }
-        break :defaultLayers layers;
-    },
-
-    /// Right-handed coordinates where z is up
-    pub fn set_pixel(self: *FrameBuffer, x_: i32, y_: i32, z: i32, color: Led) void {
-        const x = 7 - y_;
-        const y = x_;
-        const layer: *LayerData = &self.layers[@intCast(z)];
-        const newY: i32 = 7 - y;
-        const offset: i32 = 3 * newY;
-        const row: []u8 = layer.srs[@intCast(offset)..];
-        const rawColor: u8 = @intCast(@as(u3, @bitCast(color)));
-        switch (x) {
-            0 => {
-                row[0] &= ~@as(u8, 0x7);
-                row[0] |= rawColor;
-            },
-            1 => {
-                row[0] &= ~@as(u8, 0x38);
-                row[0] |= rawColor << 3;
-            },
-            2 => {
-                row[0] &= ~@as(u8, 0xC0);
-                row[0] |= rawColor << 6;
-                row[1] &= ~@as(u8, 0x1);
-                row[1] |= rawColor >> 2;
-            },
-            3 => {
-                row[1] &= ~@as(u8, 0x0e);
-                row[1] |= rawColor << 1;
-            },
-            4 => {
-                row[1] &= ~@as(u8, 0x70);
-                row[1] |= rawColor << 4;
-            },
-            5 => {
-                row[1] &= ~@as(u8, 0x80);
-                row[1] |= rawColor << 7;
-                row[2] &= ~@as(u8, 0x03);
-                row[2] |= rawColor >> 1;
-            },
-            6 => {
-                row[2] &= ~@as(u8, 0x1c);
-                row[2] |= rawColor << 2;
-            },
-            7 => {
-                row[2] &= ~@as(u8, 0xe0);
-                row[2] |= rawColor << 5;
-            },
-            else => {},
-        }
+/// Goes back to showing whatever was last render()ed, at the profile from before streaming
+/// or the last one requested while it ran
+pub fn stopStreaming() void {
+    if (!streamRunning) {
+        return;
     }
+    stopShift();
+    cmsis.NVIC.*.ICER[0] = @as(u32, 1 << cmsis.DMA1_Ch4_7_DMA2_Ch3_5_IRQn);
+    DMA2_CH4.CR.modify(.{
+        .HTIE = 0,
+    });
+    streamRunning = false;
+    applyProfile(streamPrevProfile);
+    startShift(shiftBuff);
+}
+
+/// Layers that went out twice because the producer was too slow
+pub fn streamOverruns() u32 {
+    return stream.overruns;
+}
 
-    pub fn set_channel(self: *FrameBuffer, x: u3, y: u3, z: u3, channel: Color, val: u1) void {
-        const bitoffset: u8 = (x * 3 + @intFromEnum(channel));
-        const srptr: *u8 = &self.layers[z].srs[bitoffset / 8 + (3 * (7 - y))];
+fn getDmaCh(dma: *volatile periph_types.bdma_v2.DMA, channel: comptime_int) *periph_types.bdma_v2.CH {
+    return @ptrFromInt(@intFromPtr(&dma.CH) + 20 * (channel - 1));
+}
 
-        srptr.* &= ~(@as(u8, 1) << @intCast(bitoffset % 8));
-        srptr.* |= (@as(u8, val) << @intCast(bitoffset % 8));
-    }
+/// Frame layout lives in frameBuffer.zig, so code that only works on frames builds without the hardware
+pub const Led = FrameBufferTypes.Led;
+pub const row_voxel_lsbs = FrameBufferTypes.row_voxel_lsbs;
+pub const rowPattern = FrameBufferTypes.rowPattern;
+pub const LayerData = FrameBufferTypes.LayerData;
+pub const FrameBuffer = FrameBufferTypes.FrameBuffer;
 
-    pub fn cPtr(self: *FrameBuffer) *cImport.cFrameBuffer {
-        return @ptrCast(self);
-    }
-};
+/// For handing a frame to C
+pub fn cFrameBuffer(frame: *FrameBuffer) *cImport.cFrameBuffer {
+    return @ptrCast(frame);
+}
 
 pub fn clearFrame(color: Led) void {
-    for (0..8) |x| {
-        for (0..8) |y| {
-            for (0..8) |z| {
-                drawBuff.set_pixel(@intCast(x), @intCast(y), @intCast(z), color);
-            }
-        }
-    }
+    drawBuff.clear(color);
 }
 
 pub fn setPixel(x: i32, y: i32, z: i32, color: Led) void {
     drawBuff.set_pixel(x, y, z, color);
 }
 
+/// The buffer that setPixel/clearFrame draw into. Only valid until the next render()
+pub fn getDrawBuffer() *FrameBuffer {
+    return drawBuff;
+}
+
+/// The buffer render() last handed to the shift registers
+pub fn getShownBuffer() *const FrameBuffer {
+    return if (drawBuff == &frameBuff1) &frameBuff2 else &frameBuff1;
+}
+
 pub fn render() callconv(.C) void {
-    startShift(drawBuff);
+    if (streamRunning) {
+        return;
+    }
+    Trace.frame(std.mem.asBytes(drawBuff));
+    const stamp = Latency.tracker.submit();
+    shiftBuff = Orientation.present(drawBuff);
+    startShift(shiftBuff);
+    stampOnScanEnd(stamp);
     drawBuff = if (drawBuff == &frameBuff1) &frameBuff2 else &frameBuff1;
 }
 
@@ -330,20 +541,20 @@ var BAM_buff2 = BAM_buff{};
 var BAM_renderBuff = &BAM_buff1;
 var BAM_drawBuff = &BAM_buff2;
 
+var BAM_running = false;
 var BAM_currentBitRaw: BamBitInd = 0;
 var BAM_frameSwitchPendingRaw: bool = false;
 var BAM_stopPendingRaw: bool = false;
+var BAM_profilePendingRaw: ?*const ScanProfile = null;
 const BAM_currentBit: *volatile BamBitInd = @volatileCast(&BAM_currentBitRaw);
 const BAM_frameSwitchPending: *volatile bool = @volatileCast(&BAM_frameSwitchPendingRaw);
 const BAM_stopPending: *volatile bool = @volatileCast(&BAM_stopPendingRaw);
+const BAM_profilePending: *volatile ?*const ScanProfile = @volatileCast(&BAM_profilePendingRaw);
+/// Input the frame waiting on BAM_frameSwitchPending consumed. Only touched while that's set
+var BAM_frameStamp: ?Latency.FrameStamp = null;
 
-pub const BAM_int = std.meta.Int(.unsigned, BAM_bits);
-
-pub const BAM_color = struct {
-    r: BAM_int,
-    g: BAM_int,
-    b: BAM_int,
-};
+pub const BAM_int = FrameBufferTypes.BAM_int;
+pub const BAM_color = FrameBufferTypes.BAM_color;
 
 pub const BAM_buff = struct {
     levels: [BAM_bits]FrameBuffer = .{FrameBuffer{}} ** BAM_bits,
@@ -361,7 +572,10 @@ pub const BAM_buff = struct {
 };
 
 pub fn enableBAM() void {
-    BAM_currentBit.* = 0;
+    BAM_running = true;
+    BamJitter.capture.restart();
+    // Start on the last plane so the first interrupt wraps around to the start of a cycle
+    BAM_currentBit.* = BAM_bits - 1;
     TIM15_IRQ();
 }
 
@@ -370,6 +584,7 @@ pub fn disableBAM() void {
     while (BAM_stopPending.*) {
         asm volatile ("wfi");
     }
+    BAM_running = false;
 }
 
 pub fn setPixelBAM(x: i32, y: i32, z: i32, color: BAM_color) void {
@@ -381,22 +596,45 @@ pub fn clearFrameBAM(color: BAM_color) void {
 }
 
 pub fn renderBAM() void {
+    Trace.frame(std.mem.asBytes(BAM_drawBuff));
+    BAM_frameStamp = Latency.tracker.submit();
     BAM_frameSwitchPending.* = true;
     while (BAM_frameSwitchPending.*) {
         asm volatile ("nop");
     }
 }
 
+/// Cycles spent in TIM15_IRQ, BSY wait included. Only counts once cycles.init() has been called,
+/// and only in Debug or with -Disr-cycles=true, so other builds don't pay for it on every plane
+pub const track_isr_cycles = buildMode == .Debug or @import("options").isr_cycles;
+pub const IsrCycles = struct {
+    last: u32 = 0,
+    max: u32 = 0,
+};
+pub var BAM_isrCycles = IsrCycles{};
+
 pub export fn TIM15_IRQ() callconv(.C) void {
+    const isrStart = cycles.now();
+    defer {
+        if (track_isr_cycles) {
+            BAM_isrCycles.last = cycles.since(isrStart);
+            BAM_isrCycles.max = @max(BAM_isrCycles.max, BAM_isrCycles.last);
+        }
+    }
     TIM15.SR.modify(.{ .UIF = 0 });
+    BamJitter.capture.planeEnd(BAM_currentBit.* - activeProfile.firstPlane(), isrStart);
     // UartdDebug.printIfDebug("Tim15 hit. Current bit: {}\n", .{BAM_currentBit.*}) catch {};
     std.debug.assert(TIM15.CR1.read().CEN == 0);
-    if (BAM_currentBit.* == BAM_bits - 1) {
-        BAM_currentBit.* = 0;
+    const cycleStart = BAM_currentBit.* == BAM_bits - 1;
+    // Set when this interrupt starts shifting out a new frame
+    var newFrame: ?Latency.FrameStamp = null;
+    if (cycleStart) {
+        BAM_currentBit.* = activeProfile.firstPlane();
         if (BAM_frameSwitchPending.*) {
             const temp = BAM_renderBuff;
             BAM_renderBuff = BAM_drawBuff;
             BAM_drawBuff = temp;
+            newFrame = BAM_frameStamp;
             BAM_frameSwitchPending.* = false;
         }
     } else {
@@ -412,8 +650,19 @@ pub export fn TIM15_IRQ() callconv(.C) void {
     while (SPI1.SR.read().BSY == 1) {}
     if (BAM_stopPending.*) {
         BAM_stopPending.* = false;
+        BamJitter.capture.restart();
         return;
     }
+    // Nothing is shifting and we are between BAM cycles, so it's safe to change SCLK here
+    if (cycleStart) {
+        if (BAM_profilePending.*) |profile| {
+            // Planes after this have a different lsb_time_us
+            BamJitter.capture.stop();
+            applyProfile(profile);
+            BAM_currentBit.* = profile.firstPlane();
+            BAM_profilePending.* = null;
+        }
+    }
 
     DMA2_CH4.MAR = @intFromPtr(&BAM_renderBuff.levels[BAM_currentBit.*]);
     DMA2_CH4.NDTR.modify(.{
@@ -426,9 +675,10 @@ pub export fn TIM15_IRQ() callconv(.C) void {
     DMA2_CH4.CR.modify(.{
         .EN = 1,
     });
+    stampOnScanEnd(newFrame);
 
     TIM15.CNT = @bitCast(@as(u32, 0));
-    TIM15.ARR = @bitCast(BAM_lsb_time_us << BAM_currentBit.*);
+    TIM15.ARR = @bitCast(@as(u32, activeProfile.lsb_time_us) << (BAM_currentBit.* - activeProfile.firstPlane()));
     TIM15.DIER.modify(.{
         .UIE = 1,
     });
@@ -437,18 +687,6 @@ pub export fn TIM15_IRQ() callconv(.C) void {
     });
 }
 
-// Way harder to put this inside a test block, as those need to run on the machine, which is the microcontroller
-// Random comptime block works just as well for this memory layout stuff
-comptime {
-    // Assert that our layers have the correct memory map
-    std.debug.assert(@import("builtin").target.cpu.arch.endian() == std.builtin.Endian.little);
-    std.debug.assert(@sizeOf(LayerData) == 25);
-    std.debug.assert(@offsetOf(LayerData, "layerId") == 0);
-    std.debug.assert(@offsetOf(LayerData, "srs") == 1);
-    // Assert that our frames have the correct memory map
-    std.debug.assert(@sizeOf(FrameBuffer) == 25 * 8);
-}
-
 // comptime {
 //     var frame: FrameBuffer = .{};
 //     frame.set_pixel(2, 7, 0, .{ .r = 1, .g = 1, .b = 1 });
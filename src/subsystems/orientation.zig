@@ -0,0 +1,365 @@
+/// orientation.zig
+/// Output stage that turns the whole frame to one of the cube's 24 axis-aligned orientations,
+/// so apps can keep drawing with z up no matter which face the cube is sitting on.
+/// Apps draw as usual, and render() hands the frame to present(), which remaps it into a buffer of its own.
+/// The remap is planned at comptime for every orientation and works on whole rows:
+/// at most one 8x8 transpose of voxels per block of rows, then a table-driven row copy.
+/// The orientation is either set by hand, or picked from the accelerometer
+/// (the axis gravity pulls hardest against becomes up) plus a yaw setting.
+/// In auto mode the app hands in gravity readings with follow(), so the I2C read happens in its loop
+/// (and goes through Trace) instead of in render().
+/// Only render() goes through here. BAM frames are shown as drawn.
+/// Only depends on std, so it runs under zig build test.
+const std = @import("std");
+const FrameBuffer = @import("frameBuffer.zig").FrameBuffer;
+
+/// Maps app coordinates to physical ones: phys[d] = app[perm[d]], or 7 - that when flip[d].
+/// Axes are x, y, z, as used by set_pixel
+pub const Rotation = struct {
+    perm: [3]u2,
+    flip: [3]bool,
+
+    pub fn apply(self: Rotation, a: [3]u3) [3]u3 {
+        var p: [3]u3 = undefined;
+        for (0..3) |d| {
+            const v = a[self.perm[d]];
+            p[d] = if (self.flip[d]) 7 - v else v;
+        }
+        return p;
+    }
+
+    /// outer(inner(a))
+    pub fn compose(outer: Rotation, inner: Rotation) Rotation {
+        var out: Rotation = undefined;
+        for (0..3) |d| {
+            out.perm[d] = inner.perm[outer.perm[d]];
+            out.flip[d] = outer.flip[d] != inner.flip[outer.perm[d]];
+        }
+        return out;
+    }
+};
+
+const identity = Rotation{ .perm = .{ 0, 1, 2 }, .flip = .{ false, false, false } };
+/// Quarter turn about z: phys x = -y, phys y = x
+const yawStep = Rotation{ .perm = .{ 1, 0, 2 }, .flip = .{ true, false, false } };
+
+/// Index is up * 4 + yaw. up goes +z, -z, +x, -x, +y, -y and says where the app's +z ends up.
+/// yaw turns the app about its own up. Index 0 is the identity
+pub const rotations: [24]Rotation = genRotations: {
+    @setEvalBranchQuota(100_000);
+    const perms = [6][3]u2{ .{ 0, 1, 2 }, .{ 1, 2, 0 }, .{ 2, 0, 1 }, .{ 0, 2, 1 }, .{ 2, 1, 0 }, .{ 1, 0, 2 } };
+    const ups = [6][2]u2{ .{ 2, 0 }, .{ 2, 1 }, .{ 0, 0 }, .{ 0, 1 }, .{ 1, 0 }, .{ 1, 1 } };
+    var out: [24]Rotation = undefined;
+    for (ups, 0..) |up, u| {
+        // First proper rotation that sends app z to this direction
+        const base = findBase: {
+            for (perms, 0..) |perm, p| {
+                for (0..8) |signs| {
+                    const flip = [3]bool{ signs & 1 != 0, signs & 2 != 0, signs & 4 != 0 };
+                    var negatives: u32 = @intFromBool(flip[0]) + @intFromBool(flip[1]) + @intFromBool(flip[2]);
+                    // perms 3..5 are odd
+                    if (p >= 3) negatives += 1;
+                    if (negatives % 2 != 0) continue;
+                    if (perm[up[0]] == 2 and flip[up[0]] == (up[1] == 1)) {
+                        break :findBase Rotation{ .perm = perm, .flip = flip };
+                    }
+                }
+            }
+            unreachable;
+        };
+        var yawed = base;
+        for (0..4) |yaw| {
+            out[u * 4 + yaw] = yawed;
+            yawed = yawed.compose(yawStep);
+        }
+    }
+    break :genRotations out;
+};
+pub const count = rotations.len;
+
+// ---------------
+// Row-level plans
+// ---------------
+
+/// Frame storage axes: layer (z), row (7 - x), slot within the row (7 - y)
+const L = 0;
+const R = 1;
+const S = 2;
+/// Physical/app axis stored along each storage axis, and whether it's stored backwards
+const axisOfStorage = [3]u2{ 2, 0, 1 };
+const storageOfAxis = [3]u2{ R, S, L };
+const storedFlipped = [3]bool{ false, true, true };
+
+pub const Plan = struct {
+    /// Storage axis that gets swapped with the slot axis before the row copy
+    transpose: enum { none, rows, layers },
+    /// Reverse the voxels of every row
+    reverse: bool,
+    /// Output row layer * 8 + row comes from this (transposed) input row
+    rowSource: [64]u8,
+};
+
+const Source = struct { axis: u2, flip: bool };
+
+fn makePlan(rot: Rotation) Plan {
+    // Which input storage axis feeds each output storage axis
+    var map: [3]Source = undefined;
+    for (0..3) |d| {
+        const phys = axisOfStorage[d];
+        const app = rot.perm[phys];
+        const src = storageOfAxis[app];
+        map[d] = .{ .axis = src, .flip = (storedFlipped[d] != rot.flip[phys]) != storedFlipped[src] };
+    }
+
+    var plan = Plan{ .transpose = .none, .reverse = false, .rowSource = undefined };
+    const swapped = map[S].axis;
+    if (swapped != S) {
+        plan.transpose = if (swapped == R) .rows else .layers;
+        // Swapping two input axes just renames them
+        for (&map) |*m| {
+            if (m.axis == swapped) {
+                m.axis = S;
+            } else if (m.axis == S) {
+                m.axis = swapped;
+            }
+        }
+    }
+    plan.reverse = map[S].flip;
+    for (0..8) |l| {
+        for (0..8) |r| {
+            const out = [2]u8{ @intCast(l), @intCast(r) };
+            var src: [2]u8 = undefined;
+            for (0..2) |d| {
+                src[map[d].axis] = if (map[d].flip) 7 - out[d] else out[d];
+            }
+            plan.rowSource[l * 8 + r] = src[0] * 8 + src[1];
+        }
+    }
+    return plan;
+}
+
+pub const plans: [24]Plan = genPlans: {
+    @setEvalBranchQuota(100_000);
+    var out: [24]Plan = undefined;
+    for (rotations, 0..) |rot, i| {
+        out[i] = makePlan(rot);
+    }
+    break :genPlans out;
+};
+
+/// Swaps row k voxel j with row j voxel k across 8 rows.
+/// Three rounds of swapping off-diagonal blocks (4x4, 2x2, 1x1), like a bit matrix transpose
+fn transposeVoxels(block: *[8]u32) void {
+    inline for (.{ .{ 4, 12, 0x000FFF }, .{ 2, 6, 0x03F03F }, .{ 1, 3, 0x1C71C7 } }) |round| {
+        const half = round[0];
+        const shift = round[1];
+        const mask = round[2];
+        inline for (0..8) |k| {
+            if (k & half == 0) {
+                const t = ((block[k] >> shift) ^ block[k + half]) & mask;
+                block[k + half] ^= t;
+                block[k] ^= t << shift;
+            }
+        }
+    }
+}
+
+fn reverseVoxels(row: u32) u32 {
+    var r = ((row >> 12) & 0x000FFF) | ((row & 0x000FFF) << 12);
+    r = ((r >> 6) & 0x03F03F) | ((r & 0x03F03F) << 6);
+    return ((r >> 3) & 0x1C71C7) | ((r & 0x1C71C7) << 3);
+}
+
+/// Writes src turned by plan into dst's rows. dst's layerIds are left alone
+pub fn remap(src: *const FrameBuffer, dst: *FrameBuffer, plan: *const Plan) void {
+    var rows: [8][8]u32 = undefined;
+    for (&rows, &src.layers) |*layer, *data| {
+        for (layer, 0..) |*row, r| {
+            row.* = data.getRow(@intCast(r));
+        }
+    }
+    switch (plan.transpose) {
+        .none => {},
+        .rows => for (&rows) |*layer| {
+            transposeVoxels(layer);
+        },
+        .layers => for (0..8) |r| {
+            var block: [8]u32 = undefined;
+            for (&block, rows) |*b, layer| {
+                b.* = layer[r];
+            }
+            transposeVoxels(&block);
+            for (&rows, block) |*layer, b| {
+                layer[r] = b;
+            }
+        },
+    }
+    for (plan.rowSource, 0..) |source, i| {
+        var row = rows[source / 8][source % 8];
+        if (plan.reverse) {
+            row = reverseVoxels(row);
+        }
+        dst.layers[i / 8].setRow(@intCast(i % 8), row);
+    }
+}
+
+// -------------------
+// Picking & presenting
+// -------------------
+
+/// An axis has to read more than this (in g) to become up. Tilted 45 degrees, no axis gets there,
+/// so the picture doesn't flicker between two faces
+const up_threshold = 0.8;
+/// Sensor axis and sign lined up with each cube axis. The identity assumes the IMU is mounted square to the cube
+pub const sensor_to_cube = Rotation{ .perm = .{ 0, 1, 2 }, .flip = .{ false, false, false } };
+
+var current: u5 = 0;
+var yaw: u2 = 0;
+var auto = false;
+
+var outBuff1: FrameBuffer = .{};
+var outBuff2: FrameBuffer = .{};
+var outBuff: *FrameBuffer = &outBuff1;
+
+/// Fixes the orientation, and turns auto mode off
+pub fn set(index: u5) void {
+    std.debug.assert(index < count);
+    auto = false;
+    current = index;
+}
+
+pub fn get() u5 {
+    return current;
+}
+
+/// Follows the gravity readings handed to follow() from now on
+pub fn setAuto(on: bool) void {
+    auto = on;
+}
+
+pub fn isAuto() bool {
+    return auto;
+}
+
+/// In auto mode, turns up towards accel (raw counts, imu.readGravity()). Does nothing otherwise.
+/// Call it from the app loop, every frame or slower
+pub fn follow(accel: [3]i16) void {
+    if (!auto) {
+        return;
+    }
+    if (pickUp(accel)) |up| {
+        current = up | yaw;
+    }
+}
+
+/// Turns the picture about up by quarter turns
+pub fn setYaw(quarters: u2) void {
+    yaw = quarters;
+    current = (current & ~@as(u5, 3)) | yaw;
+}
+
+/// Raw accelerometer counts (imu.readGravity) turned to the cube's x, y, z
+pub fn toCube(accel: [3]i16) [3]i32 {
+    var cube: [3]i32 = undefined;
+    for (0..3) |d| {
+        const v: i32 = accel[sensor_to_cube.perm[d]];
+        cube[d] = if (sensor_to_cube.flip[d]) -v else v;
+    }
+    return cube;
+}
+
+/// Index of the orientation that puts the app's up along the strongest gravity reading, if there is one
+pub fn pickUp(accel: [3]i16) ?u5 {
+    const threshold: i32 = @intFromFloat(up_threshold * 16384.0);
+    const cube = toCube(accel);
+    // Same order as rotations: z, x, y
+    const order = [3]u2{ 2, 0, 1 };
+    for (order, 0..) |axis, i| {
+        // A resting accelerometer reads +1 g pointing up
+        if (cube[axis] > threshold) return @as(u5, @intCast(i * 8));
+        if (cube[axis] < -threshold) return @as(u5, @intCast(i * 8 + 4));
+    }
+    return null;
+}
+
+/// Called by render(). Returns the frame to shift out, which is src itself when nothing needs turning
+pub fn present(src: *const FrameBuffer) *const FrameBuffer {
+    if (current == 0) {
+        return src;
+    }
+    outBuff = if (outBuff == &outBuff1) &outBuff2 else &outBuff1;
+    remap(src, outBuff, &plans[current]);
+    return outBuff;
+}
+
+/// Colour of a voxel in the test frame, different enough between neighbours to catch any mixup
+fn testVoxel(x: usize, y: usize, z: usize) u3 {
+    return @truncate(x * 5 + y * 3 + z * 7 + x * y + y * z);
+}
+
+test "all 24 orientations are different" {
+    // All 24 different, and index 0 does nothing
+    for (rotations, 0..) |a, i| {
+        for (rotations[i + 1 ..]) |b| {
+            try std.testing.expect(!std.meta.eql(a, b));
+        }
+    }
+    try std.testing.expect(std.meta.eql(rotations[0], identity));
+    try std.testing.expect(plans[0].transpose == .none and !plans[0].reverse);
+}
+
+// Every orientation checked against turning the frame one voxel at a time
+test "remap agrees with turning every voxel" {
+    var src = FrameBuffer{};
+    for (0..8) |x| {
+        for (0..8) |y| {
+            for (0..8) |z| {
+                src.set_pixel(@intCast(x), @intCast(y), @intCast(z), @bitCast(testVoxel(x, y, z)));
+            }
+        }
+    }
+    for (rotations, plans, 0..) |rot, plan, i| {
+        // Up ends up where the index says
+        const upDir = rot.apply(.{ 0, 0, 7 });
+        const upAxis = [3]u2{ 2, 0, 1 }[i / 8];
+        try std.testing.expect(upDir[upAxis] == @as(u3, if ((i / 4) % 2 == 0) 7 else 0));
+
+        var reference = FrameBuffer{};
+        var seen = [_]bool{false} ** 512;
+        for (0..8) |x| {
+            for (0..8) |y| {
+                for (0..8) |z| {
+                    const p = rot.apply(.{ @intCast(x), @intCast(y), @intCast(z) });
+                    seen[@as(usize, p[0]) * 64 + @as(usize, p[1]) * 8 + p[2]] = true;
+                    reference.set_pixel(p[0], p[1], p[2], @bitCast(testVoxel(x, y, z)));
+                }
+            }
+        }
+        // Bijection
+        try std.testing.expect(std.mem.allEqual(bool, &seen, true));
+
+        var out = FrameBuffer{};
+        remap(&src, &out, &plan);
+        try std.testing.expect(std.mem.eql(u8, std.mem.asBytes(&out), std.mem.asBytes(&reference)));
+    }
+}
+
+test "picking up from gravity" {
+    try std.testing.expect(pickUp(.{ 0, 0, 16384 }).? == 0);
+    try std.testing.expect(pickUp(.{ -16000, 0, 1000 }).? == 12);
+    try std.testing.expect(pickUp(.{ 11000, 11000, 0 }) == null);
+
+    // follow() only turns things in auto mode, and keeps the yaw
+    set(0);
+    follow(.{ -16000, 0, 1000 });
+    try std.testing.expect(get() == 0);
+    setAuto(true);
+    setYaw(2);
+    follow(.{ -16000, 0, 1000 });
+    try std.testing.expect(get() == 12 | 2);
+    // Tilted, so it stays put
+    follow(.{ 11000, 11000, 0 });
+    try std.testing.expect(get() == 12 | 2);
+    setAuto(false);
+    set(0);
+}
@@ -8,12 +8,17 @@ extern var APP_NUM: c_int;
 extern var RUNNING_APP: c_int;
 
 pub fn screen_init() void {
-    const MENU = "Select App:";
-
     //init_exti();
     cImport.cMenuDisp.LCD_Setup();
     // SETS UP STARTING SCREEN
     cImport.cMenuDisp.LCD_Clear(cImport.cMenuDisp.SCREEN_WHITE);
+    draw_menu();
+}
+
+/// Everything screen_init draws after clearing the screen
+pub fn draw_menu() void {
+    const MENU = "Select App:";
+
     cImport.cMenuDisp.LCD_DrawFillRectangle(204, 0, 240, 320, cImport.cMenuDisp.LIGHTBLUE); // menu background
     cImport.cMenuDisp.LCD_DrawString(209, 5, cImport.cMenuDisp.SCREEN_WHITE, cImport.cMenuDisp.LIGHTBLUE, MENU, 26); // menu text
     // loads first 7 applications
@@ -0,0 +1,685 @@
+/// voxelizer.zig
+/// Draws small indexed triangle meshes into a voxel grid (a compositor Mask), all in fixed point.
+/// Vertices are in 1/256 voxels. A Transform (from any FpRotor, like imu.getZeroedOrientation()) turns and places them.
+/// Surfaces: each triangle gets clipped to the slab of every layer it crosses, and the clipped polygon
+/// is scan converted with edge functions, conservatively: every voxel the triangle touches lights up.
+/// Solids: on top of that, every voxel column flips parity at each triangle it passes through,
+/// which fills closed meshes. Meshes that stick out of the cube still fill correctly:
+/// edge functions are worked out in i64, so a transformed vertex can be anywhere an i32 reaches.
+/// Meshes come from OBJ files parsed at compile time (parseObj), or get generated (torus).
+const std = @import("std");
+const fp = @import("../util/fixedPoint.zig");
+const Compositor = @import("compositor.zig");
+
+pub const Grid = Compositor.Mask;
+
+/// Fixed point voxels: 256 per voxel. Voxel centres sit on whole numbers, so voxel 0 spans -0.5..0.5
+pub const unit = 256;
+const half = unit / 2;
+
+pub const max_vertices = 256;
+
+pub const Mesh = struct {
+    /// Model coordinates, in 1/256 voxels. Keep them within 32 voxels of the origin
+    vertices: []const [3]i16,
+    triangles: []const [3]u16,
+};
+
+pub const Mode = enum { surface, solid };
+
+pub const Transform = struct {
+    /// Rotation times scale, Q14. m[i][j] takes model axis j to cube axis i
+    m: [3][3]i32,
+    /// Where the model's origin ends up, in 1/256 voxels
+    offset: [3]i32,
+
+    pub const centre = [3]i32{ 7 * half, 7 * half, 7 * half };
+
+    pub fn identity() Transform {
+        return .{
+            .m = .{ .{ 1 << 14, 0, 0 }, .{ 0, 1 << 14, 0 }, .{ 0, 0, 1 << 14 } },
+            .offset = centre,
+        };
+    }
+
+    /// rotor's rotation, scaled by scale / 256 (up to 4x), about the middle of the cube
+    pub fn fromRotor(rotor: anytype, scale: i32) Transform {
+        const Scalar = @TypeOf(rotor.scalar);
+        const Vec = fp.FpVector(Scalar);
+        const one = Scalar{ .raw = 1 << Scalar.fraction_bits };
+        const zero = Scalar{ .raw = 0 };
+        const axes = [3]Vec{
+            .{ .x = one, .y = zero, .z = zero },
+            .{ .x = zero, .y = one, .z = zero },
+            .{ .x = zero, .y = zero, .z = one },
+        };
+        var out = Transform{ .m = undefined, .offset = centre };
+        for (axes, 0..) |axis, j| {
+            const turned = rotor.rotateVector(axis);
+            const column = [3]Scalar{ turned.x, turned.y, turned.z };
+            for (column, 0..) |c, i| {
+                out.m[i][j] = @divTrunc(toQ14(c) * scale, unit);
+            }
+        }
+        return out;
+    }
+
+    fn toQ14(v: anytype) i32 {
+        const bits = @TypeOf(v).fraction_bits;
+        if (bits >= 14) {
+            return @intCast(v.raw >> (bits - 14));
+        }
+        return @as(i32, @intCast(v.raw)) << (14 - bits);
+    }
+
+    pub fn apply(self: *const Transform, v: [3]i16) [3]i32 {
+        var out: [3]i32 = undefined;
+        for (&out, self.m, self.offset) |*o, row, offset| {
+            o.* = ((row[0] * v[0] + row[1] * v[1] + row[2] * v[2]) >> 14) + offset;
+        }
+        return out;
+    }
+};
+
+/// Draws mesh into out, on top of what's already there
+pub fn voxelize(mesh: *const Mesh, xf: *const Transform, mode: Mode, out: *Grid) void {
+    std.debug.assert(mesh.vertices.len <= max_vertices);
+    var points: [max_vertices][3]i32 = undefined;
+    for (mesh.vertices, points[0..mesh.vertices.len]) |v, *p| {
+        p.* = xf.apply(v);
+    }
+    voxelizePoints(points[0..mesh.vertices.len], mesh.triangles, mode, out);
+}
+
+/// voxelize() once the vertices are in cube coordinates
+fn voxelizePoints(points: []const [3]i32, triangles: []const [3]u16, mode: Mode, out: *Grid) void {
+    // Bit z of a column is layer z, columns are indexed like a Mask layer's bits
+    var columns: [64]u8 = .{0} ** 64;
+    for (triangles) |indices| {
+        const tri = [3][3]i32{ points[indices[0]], points[indices[1]], points[indices[2]] };
+        surfaceTriangle(&tri, out);
+        if (mode == .solid) {
+            parityTriangle(&tri, &columns);
+        }
+    }
+    if (mode == .solid) {
+        for (columns, 0..) |column, i| {
+            for (&out.layers, 0..) |*l, z| {
+                l.* |= @as(u64, (column >> @intCast(z)) & 1) << @intCast(i);
+            }
+        }
+    }
+}
+
+fn bitIndex(x: i32, y: i32) u6 {
+    return @intCast(8 * (7 - x) + (7 - y));
+}
+
+/// First cell whose square reaches v, and last one
+fn cellFrom(v: i32) i32 {
+    return @max(0, -@divFloor(half - v, unit));
+}
+
+fn cellTo(v: i32) i32 {
+    return @min(7, @divFloor(v + half, unit));
+}
+
+// -----------------
+// Surface (slabs)
+// -----------------
+
+/// A triangle cut by both faces of a slab has at most 5 corners
+const Polygon = struct {
+    points: [5][3]i32 = undefined,
+    len: usize = 0,
+
+    fn push(self: *Polygon, p: [3]i32) void {
+        self.points[self.len] = p;
+        self.len += 1;
+    }
+};
+
+/// Point on a -> b where z = plane
+fn atZ(a: [3]i32, b: [3]i32, plane: i32) [3]i32 {
+    const num: i64 = plane - a[2];
+    const den: i64 = b[2] - a[2];
+    return .{
+        a[0] + @as(i32, @intCast(@divTrunc((b[0] - a[0]) * num, den))),
+        a[1] + @as(i32, @intCast(@divTrunc((b[1] - a[1]) * num, den))),
+        plane,
+    };
+}
+
+/// The part of poly at or above z = plane (or at or below it)
+fn clipZ(poly: *const Polygon, plane: i32, above: bool) Polygon {
+    var out = Polygon{};
+    for (0..poly.len) |i| {
+        const a = poly.points[i];
+        const b = poly.points[(i + 1) % poly.len];
+        const keepA = if (above) a[2] >= plane else a[2] <= plane;
+        const keepB = if (above) b[2] >= plane else b[2] <= plane;
+        if (keepA) {
+            out.push(a);
+        }
+        if (keepA != keepB) {
+            out.push(atZ(a, b, plane));
+        }
+    }
+    return out;
+}
+
+fn surfaceTriangle(tri: *const [3][3]i32, out: *Grid) void {
+    const zMin = @min(tri[0][2], tri[1][2], tri[2][2]);
+    const zMax = @max(tri[0][2], tri[1][2], tri[2][2]);
+    var whole = Polygon{};
+    for (tri) |v| {
+        whole.push(v);
+    }
+    var z = cellFrom(zMin);
+    while (z <= cellTo(zMax)) : (z += 1) {
+        const lo = z * unit - half;
+        const hi = z * unit + half;
+        if (zMin >= lo and zMax <= hi) {
+            rasterSlab(&whole, &out.layers[@intCast(z)]);
+        } else {
+            const below = clipZ(&whole, lo, true);
+            if (below.len == 0) continue;
+            const slab = clipZ(&below, hi, false);
+            if (slab.len == 0) continue;
+            rasterSlab(&slab, &out.layers[@intCast(z)]);
+        }
+    }
+}
+
+/// Sets every cell of the layer that the polygon's xy shadow touches.
+/// A cell is in when no polygon edge has the whole cell on its outside (plus the bounding box test),
+/// which is exact for convex polygons
+fn rasterSlab(poly: *const Polygon, layer: *u64) void {
+    const pts = poly.points[0..poly.len];
+    var xMin = pts[0][0];
+    var xMax = pts[0][0];
+    var yMin = pts[0][1];
+    var yMax = pts[0][1];
+    var area: i64 = 0;
+    for (pts, 0..) |p, i| {
+        const q = pts[(i + 1) % pts.len];
+        xMin = @min(xMin, p[0]);
+        xMax = @max(xMax, p[0]);
+        yMin = @min(yMin, p[1]);
+        yMax = @max(yMax, p[1]);
+        area += @as(i64, p[0]) * q[1] - @as(i64, q[0]) * p[1];
+    }
+    const x0 = cellFrom(xMin);
+    const x1 = cellTo(xMax);
+    const y0 = cellFrom(yMin);
+    const y1 = cellTo(yMax);
+    if (x0 > x1 or y0 > y1) {
+        return;
+    }
+
+    // Flip clockwise polygons so inside is >= 0. Flat ones work either way round
+    const sign: i64 = if (area < 0) -1 else 1;
+    // Each edge function at cell (x0, y0), pushed out by half a cell towards the edge's inside,
+    // and how much it changes per cell
+    var rowStart: [5]i64 = undefined;
+    var stepX: [5]i64 = undefined;
+    var stepY: [5]i64 = undefined;
+    for (pts, 0..) |p, i| {
+        const q = pts[(i + 1) % pts.len];
+        const dx = (q[0] - p[0]) * sign;
+        const dy = (q[1] - p[1]) * sign;
+        const slack = half * (@as(i64, @intCast(@abs(dx))) + @as(i64, @intCast(@abs(dy))));
+        rowStart[i] = dx * (y0 * unit - p[1]) - dy * (x0 * unit - p[0]) + slack;
+        stepX[i] = -dy * unit;
+        stepY[i] = dx * unit;
+    }
+
+    var x = x0;
+    while (x <= x1) : (x += 1) {
+        var e = rowStart;
+        var y = y0;
+        while (y <= y1) : (y += 1) {
+            var inside = true;
+            for (e[0..pts.len]) |v| {
+                inside = inside and v >= 0;
+            }
+            if (inside) {
+                layer.* |= @as(u64, 1) << bitIndex(x, y);
+            }
+            for (e[0..pts.len], stepY[0..pts.len]) |*v, s| {
+                v.* += s;
+            }
+        }
+        for (rowStart[0..pts.len], stepX[0..pts.len]) |*v, s| {
+            v.* += s;
+        }
+    }
+}
+
+// ---------------
+// Solid (parity)
+// ---------------
+
+/// Tie break for column centres exactly on an edge, given the edge turned so the triangle is on its left.
+/// Two triangles on either side of a shared edge walk it in opposite directions, so exactly one of them
+/// claims the centre. Two on the same side (where the mesh folds over, seen from above) both claim it or
+/// neither does, so the column's parity comes out the same either way
+fn ownsEdge(dx: i64, dy: i64) bool {
+    return dy > 0 or (dy == 0 and dx < 0);
+}
+
+/// Flips every voxel of each column the triangle covers, from where the triangle crosses it up to the top
+fn parityTriangle(tri: *const [3][3]i32, columns: *[64]u8) void {
+    const a = tri[0];
+    const b = tri[1];
+    const c = tri[2];
+    const area = @as(i64, b[0] - a[0]) * (c[1] - a[1]) - @as(i64, b[1] - a[1]) * (c[0] - a[0]);
+    if (area == 0) {
+        // Edge on from above, no column goes through it
+        return;
+    }
+    const sign: i64 = if (area < 0) -1 else 1;
+    // Column centres, not cells
+    const x0 = @max(0, -@divFloor(-@min(a[0], b[0], c[0]), unit));
+    const x1 = @min(7, @divFloor(@max(a[0], b[0], c[0]), unit));
+    const y0 = @max(0, -@divFloor(-@min(a[1], b[1], c[1]), unit));
+    const y1 = @min(7, @divFloor(@max(a[1], b[1], c[1]), unit));
+
+    var x = x0;
+    while (x <= x1) : (x += 1) {
+        var y = y0;
+        while (y <= y1) : (y += 1) {
+            // w[i] is the edge opposite vertex i, which is also vertex i's barycentric weight times area
+            var w: [3]i64 = undefined;
+            var inside = true;
+            for (&w, 0..) |*wi, i| {
+                const p = tri[(i + 1) % 3];
+                const q = tri[(i + 2) % 3];
+                const dx: i64 = q[0] - p[0];
+                const dy: i64 = q[1] - p[1];
+                wi.* = dx * (y * unit - p[1]) - dy * (x * unit - p[0]);
+                inside = inside and (wi.* * sign > 0 or (wi.* == 0 and ownsEdge(dx * sign, dy * sign)));
+            }
+            if (!inside) {
+                continue;
+            }
+            const depth = @divFloor(w[0] * a[2] + w[1] * b[2] + w[2] * c[2], area);
+            // First layer whose centre is above the crossing
+            const first = @max(0, @divFloor(depth, unit) + 1);
+            if (first < 8) {
+                columns[bitIndex(x, y)] ^= @as(u8, 0xFF) << @intCast(first);
+            }
+        }
+    }
+}
+
+// -------
+// Meshes
+// -------
+
+/// Reads the v and f lines of a Wavefront OBJ at compile time, fanning bigger faces into triangles.
+/// The model is centred on its bounding box and scaled so its longest side is `size` voxels.
+/// Use with @embedFile
+pub fn parseObj(comptime text: []const u8, comptime size: comptime_float) Mesh {
+    return comptime parse: {
+        @setEvalBranchQuota(1_000_000);
+        var vertexCount = 0;
+        var triangleCount = 0;
+        var lines = std.mem.tokenizeAny(u8, text, "\r\n");
+        while (lines.next()) |line| {
+            var words = std.mem.tokenizeAny(u8, line, " \t");
+            const kind = words.next() orelse continue;
+            if (std.mem.eql(u8, kind, "v")) {
+                vertexCount += 1;
+            } else if (std.mem.eql(u8, kind, "f")) {
+                var corners = 0;
+                while (words.next()) |_| corners += 1;
+                triangleCount += corners - 2;
+            }
+        }
+        if (vertexCount > max_vertices) {
+            @compileError(std.fmt.comptimePrint("OBJ has {} vertices, voxelize() takes at most {}", .{ vertexCount, max_vertices }));
+        }
+
+        var points: [vertexCount][3]f64 = undefined;
+        var triangles: [triangleCount][3]u16 = undefined;
+        var v = 0;
+        var t = 0;
+        lines = std.mem.tokenizeAny(u8, text, "\r\n");
+        while (lines.next()) |line| {
+            var words = std.mem.tokenizeAny(u8, line, " \t");
+            const kind = words.next() orelse continue;
+            if (std.mem.eql(u8, kind, "v")) {
+                for (&points[v]) |*c| {
+                    c.* = std.fmt.parseFloat(f64, words.next().?) catch @compileError("Bad OBJ vertex: " ++ line);
+                }
+                v += 1;
+            } else if (std.mem.eql(u8, kind, "f")) {
+                var face: [3]u16 = undefined;
+                var corner = 0;
+                while (words.next()) |word| : (corner += 1) {
+                    // v, v/vt, v//vn or v/vt/vn. Negative counts back from the last vertex so far
+                    const index = std.fmt.parseInt(i32, word[0 .. std.mem.indexOfScalar(u8, word, '/') orelse word.len], 10) catch
+                        @compileError("Bad OBJ face: " ++ line);
+                    const resolved = if (index < 0) v + index else index - 1;
+                    if (resolved < 0 or resolved >= vertexCount) {
+                        @compileError("OBJ face points past the vertices: " ++ line);
+                    }
+                    if (corner < 2) {
+                        face[corner] = resolved;
+                    } else {
+                        face[2] = resolved;
+                        triangles[t] = face;
+                        t += 1;
+                        face[1] = resolved;
+                    }
+                }
+            }
+        }
+
+        var lo = points[0];
+        var hi = points[0];
+        for (points) |p| {
+            for (0..3) |d| {
+                lo[d] = @min(lo[d], p[d]);
+                hi[d] = @max(hi[d], p[d]);
+            }
+        }
+        const longest = @max(hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2]);
+        var vertices: [vertexCount][3]i16 = undefined;
+        for (&vertices, points) |*out, p| {
+            for (0..3) |d| {
+                out[d] = @intFromFloat(@round((p[d] - (lo[d] + hi[d]) / 2) * size / longest * unit));
+            }
+        }
+        const finalVertices = vertices;
+        const finalTriangles = triangles;
+        break :parse .{ .vertices = &finalVertices, .triangles = &finalTriangles };
+    };
+}
+
+/// Ring of radius major voxels around z, tube radius minor. 2 * segments * sides triangles
+pub fn torus(comptime major: comptime_float, comptime minor: comptime_float, comptime segments: comptime_int, comptime sides: comptime_int) Mesh {
+    return comptime build: {
+        @setEvalBranchQuota(100_000);
+        if (segments * sides > max_vertices) {
+            @compileError(std.fmt.comptimePrint("Torus has {} vertices, voxelize() takes at most {}", .{ segments * sides, max_vertices }));
+        }
+        var vertices: [segments * sides][3]i16 = undefined;
+        var triangles: [2 * segments * sides][3]u16 = undefined;
+        for (0..segments) |i| {
+            const around = 2 * std.math.pi * @as(f64, @floatFromInt(i)) / segments;
+            for (0..sides) |j| {
+                const tube = 2 * std.math.pi * @as(f64, @floatFromInt(j)) / sides;
+                const r = major + minor * @cos(tube);
+                vertices[i * sides + j] = .{
+                    @intFromFloat(@round(r * @cos(around) * unit)),
+                    @intFromFloat(@round(r * @sin(around) * unit)),
+                    @intFromFloat(@round(minor * @sin(tube) * unit)),
+                };
+                const next = (i + 1) % segments;
+                const a = i * sides + j;
+                const b = next * sides + j;
+                const c = next * sides + (j + 1) % sides;
+                const d = i * sides + (j + 1) % sides;
+                triangles[2 * a] = .{ a, b, c };
+                triangles[2 * a + 1] = .{ a, c, d };
+            }
+        }
+        const finalVertices = vertices;
+        const finalTriangles = triangles;
+        break :build .{ .vertices = &finalVertices, .triangles = &finalTriangles };
+    };
+}
+
+// Reference voxelizer in floats, one voxel at a time
+const Reference = struct {
+    fn cross(a: [3]f64, b: [3]f64) [3]f64 {
+        return .{ a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+    }
+
+    /// Separating axis test between a triangle and the box of half size h around centre
+    fn touches(tri: [3][3]f64, centre: [3]f64, h: f64) bool {
+        var v: [3][3]f64 = undefined;
+        for (0..3) |i| {
+            for (0..3) |d| {
+                v[i][d] = tri[i][d] - centre[d];
+            }
+        }
+        var e: [3][3]f64 = undefined;
+        for (0..3) |i| {
+            for (0..3) |d| {
+                e[i][d] = v[(i + 1) % 3][d] - v[i][d];
+            }
+        }
+        const boxAxes = [3][3]f64{ .{ 1, 0, 0 }, .{ 0, 1, 0 }, .{ 0, 0, 1 } };
+        var axes: [13][3]f64 = undefined;
+        axes[0..3].* = boxAxes;
+        axes[3] = cross(e[0], e[1]);
+        for (0..3) |i| {
+            for (0..3) |k| {
+                axes[4 + 3 * i + k] = cross(boxAxes[k], e[i]);
+            }
+        }
+        for (axes) |axis| {
+            var lo: f64 = std.math.inf(f64);
+            var hi: f64 = -std.math.inf(f64);
+            for (v) |p| {
+                const d = axis[0] * p[0] + axis[1] * p[1] + axis[2] * p[2];
+                lo = @min(lo, d);
+                hi = @max(hi, d);
+            }
+            const r = h * (@abs(axis[0]) + @abs(axis[1]) + @abs(axis[2]));
+            if (lo > r or hi < -r) return false;
+        }
+        return true;
+    }
+
+    fn toVoxels(points: []const [3]i32, indices: [3]u16) [3][3]f64 {
+        var tri: [3][3]f64 = undefined;
+        for (&tri, indices) |*v, i| {
+            for (v, points[i]) |*c, p| {
+                c.* = @as(f64, @floatFromInt(p)) / unit;
+            }
+        }
+        return tri;
+    }
+
+    fn surface(points: []const [3]i32, triangles: []const [3]u16, h: f64) Grid {
+        var out = Grid{};
+        for (triangles) |indices| {
+            const tri = toVoxels(points, indices);
+            // Only the voxels around the triangle's bounding box, or this takes forever at compile time
+            var lo: [3]i32 = undefined;
+            var hi: [3]i32 = undefined;
+            for (0..3) |d| {
+                lo[d] = @max(0, @as(i32, @intFromFloat(@ceil(@min(tri[0][d], tri[1][d], tri[2][d]) - h))));
+                hi[d] = @min(7, @as(i32, @intFromFloat(@floor(@max(tri[0][d], tri[1][d], tri[2][d]) + h))));
+            }
+            var x = lo[0];
+            while (x <= hi[0]) : (x += 1) {
+                var y = lo[1];
+                while (y <= hi[1]) : (y += 1) {
+                    var z = lo[2];
+                    while (z <= hi[2]) : (z += 1) {
+                        const centre = [3]f64{ @floatFromInt(x), @floatFromInt(y), @floatFromInt(z) };
+                        if (touches(tri, centre, h)) {
+                            out.set(x, y, z, true);
+                        }
+                    }
+                }
+            }
+        }
+        return out;
+    }
+
+    /// Odd number of triangles below the voxel centre
+    fn solid(points: []const [3]i32, triangles: []const [3]u16) Grid {
+        var out = Grid{};
+        for (triangles) |indices| {
+            const t = toVoxels(points, indices);
+            const area = (t[1][0] - t[0][0]) * (t[2][1] - t[0][1]) - (t[1][1] - t[0][1]) * (t[2][0] - t[0][0]);
+            if (area == 0) continue;
+            for (0..8) |xi| {
+                for (0..8) |yi| {
+                    const x: f64 = @floatFromInt(xi);
+                    const y: f64 = @floatFromInt(yi);
+                    const w0 = ((t[2][0] - t[1][0]) * (y - t[1][1]) - (t[2][1] - t[1][1]) * (x - t[1][0])) / area;
+                    const w1 = ((t[0][0] - t[2][0]) * (y - t[2][1]) - (t[0][1] - t[2][1]) * (x - t[2][0])) / area;
+                    const w2 = 1 - w0 - w1;
+                    if (w0 < 0 or w1 < 0 or w2 < 0) continue;
+                    const depth = w0 * t[0][2] + w1 * t[1][2] + w2 * t[2][2];
+                    for (0..8) |zi| {
+                        if (depth < @as(f64, @floatFromInt(zi))) {
+                            out.layers[zi] ^= @as(u64, 1) << @intCast(8 * (7 - xi) + (7 - yi));
+                        }
+                    }
+                }
+            }
+        }
+        return out;
+    }
+
+    fn subset(a: Grid, b: Grid) bool {
+        return std.mem.eql(u64, &a.intersect(b).layers, &a.layers);
+    }
+};
+
+/// Axis-aligned box with corners at lo and hi in every axis (1/256 voxels), 12 triangles facing out (or in)
+fn box(lo: i32, hi: i32, inward: bool) struct { points: [8][3]i32, triangles: [12][3]u16 } {
+    var points: [8][3]i32 = undefined;
+    for (&points, 0..) |*p, i| {
+        p.* = .{
+            if (i & 1 != 0) hi else lo,
+            if (i & 2 != 0) hi else lo,
+            if (i & 4 != 0) hi else lo,
+        };
+    }
+    // Corner bits are x, y, z. Each face goes round its 4 corners, and splits along corner 0 - corner 2
+    const faces = [6][4]u16{ .{ 0, 2, 6, 4 }, .{ 1, 3, 7, 5 }, .{ 0, 1, 5, 4 }, .{ 2, 3, 7, 6 }, .{ 0, 1, 3, 2 }, .{ 4, 5, 7, 6 } };
+    var triangles: [12][3]u16 = undefined;
+    for (faces, 0..) |f, i| {
+        triangles[2 * i] = .{ f[0], f[1], f[2] };
+        triangles[2 * i + 1] = .{ f[0], f[2], f[3] };
+    }
+    // Wind each one by which way its normal points
+    const mid = @divTrunc(lo + hi, 2);
+    for (&triangles) |*tri| {
+        const a = points[tri[0]];
+        const b = points[tri[1]];
+        const c = points[tri[2]];
+        var dot: i64 = 0;
+        for (0..3) |d| {
+            const e = (d + 1) % 3;
+            const f = (d + 2) % 3;
+            const normal = @as(i64, b[e] - a[e]) * (c[f] - a[f]) - @as(i64, b[f] - a[f]) * (c[e] - a[e]);
+            dot += normal * (a[d] + b[d] + c[d] - 3 * mid);
+        }
+        if ((dot < 0) != inward) {
+            std.mem.swap(u16, &tri[1], &tri[2]);
+        }
+    }
+    return .{ .points = points, .triangles = triangles };
+}
+
+fn fill(lo: i32, hi: i32) Grid {
+    var g = Grid{};
+    var x = lo;
+    while (x <= hi) : (x += 1) {
+        var y = lo;
+        while (y <= hi) : (y += 1) {
+            var z = lo;
+            while (z <= hi) : (z += 1) {
+                g.set(x, y, z, true);
+            }
+        }
+    }
+    return g;
+}
+
+test "agrees with the float reference at any angle" {
+    const Angle = fp.FixedPoint(16, 16, .signed);
+    const Rotor = fp.FpRotor(Angle);
+    const ring = comptime torus(2.5, 1.2, 12, 6);
+
+    // Three arbitrary turns: about z, about (1, 1, 0) and about (1, -2, 3)
+    const turns = [_][4]f64{ .{ 0.4, 0, 0, 1 }, .{ 1.9, 0.7071, 0.7071, 0 }, .{ 2.6, 0.2673, -0.5345, 0.8018 } };
+    inline for (turns) |turn| {
+        const s = @sin(turn[0] / 2);
+        const rotor = Rotor{
+            .scalar = Angle.fromFloat(@cos(turn[0] / 2)),
+            .yz = Angle.fromFloat(s * turn[1]),
+            .zx = Angle.fromFloat(s * turn[2]),
+            .xy = Angle.fromFloat(s * turn[3]),
+        };
+        const xf = Transform.fromRotor(rotor, unit);
+        var points: [ring.vertices.len][3]i32 = undefined;
+        for (&points, ring.vertices) |*p, v| {
+            p.* = xf.apply(v);
+        }
+
+        // Surface: everything the triangles clearly touch, nothing they clearly miss.
+        // Slab clipping rounds to 1/256 voxel, so "clearly" is 1/64 voxel
+        var surface = Grid{};
+        voxelizePoints(&points, ring.triangles, .surface, &surface);
+        try std.testing.expect(Reference.subset(Reference.surface(&points, ring.triangles, 0.5 - 1.0 / 64.0), surface));
+        try std.testing.expect(Reference.subset(surface, Reference.surface(&points, ring.triangles, 0.5 + 1.0 / 64.0)));
+
+        // Solid: parity fill agrees with casting a ray from every voxel, and covers the surface
+        var solid = Grid{};
+        voxelizePoints(&points, ring.triangles, .solid, &solid);
+        try std.testing.expectEqualSlices(u64, &Reference.solid(&points, ring.triangles).unite(surface).layers, &solid.layers);
+    }
+}
+
+test "column centres on shared edges count once" {
+    // Whole voxels, so columns run straight down the top and bottom faces' diagonals and along their sides
+    for ([_]bool{ false, true }) |inward| {
+        const b = box(1 * unit, 5 * unit, inward);
+        var solid = Grid{};
+        voxelizePoints(&b.points, &b.triangles, .solid, &solid);
+        try std.testing.expectEqualSlices(u64, &fill(1, 5).layers, &solid.layers);
+    }
+}
+
+test "meshes far bigger than the cube still fill" {
+    // Edge functions of this one don't fit in an i32
+    const b = box(-200 * unit, 207 * unit, false);
+    var solid = Grid{};
+    voxelizePoints(&b.points, &b.triangles, .solid, &solid);
+    try std.testing.expectEqual(@as(u32, 512), solid.count());
+    var surface = Grid{};
+    voxelizePoints(&b.points, &b.triangles, .surface, &surface);
+    try std.testing.expectEqual(@as(u32, 0), surface.count());
+
+    // Sticking out of one side: the part inside is filled up to the wall
+    const wall = box(3 * unit, 40 * unit, false);
+    var cut = Grid{};
+    voxelizePoints(&wall.points, &wall.triangles, .solid, &cut);
+    try std.testing.expectEqualSlices(u64, &fill(3, 7).layers, &cut.layers);
+}
+
+test "identity puts the origin in the middle of the cube" {
+    const flat = Mesh{
+        .vertices = &.{ .{ -unit, -unit, 0 }, .{ unit, -unit, 0 }, .{ 0, unit, 0 } },
+        .triangles = &.{.{ 0, 1, 2 }},
+    };
+    var g = Grid{};
+    voxelize(&flat, &Transform.identity(), .surface, &g);
+    try std.testing.expect(g.get(3, 3, 3) and g.get(4, 4, 4) and !g.get(1, 1, 3));
+}
+
+test "OBJ parsing" {
+    // Indices are 1 based, faces fan out, and the model gets centred and scaled
+    const quad = comptime parseObj(
+        \\# a square
+        \\v 0 0 0
+        \\v 2 0 0
+        \\v 2 2 0
+        \\v 0 2 0
+        \\f 1/1 2/2 3/3 -1
+    , 4);
+    try std.testing.expectEqual(@as(usize, 2), quad.triangles.len);
+    try std.testing.expectEqualSlices(u16, &[3]u16{ 0, 2, 3 }, &quad.triangles[1]);
+    try std.testing.expect(quad.vertices[0][0] == -2 * unit and quad.vertices[2][1] == 2 * unit);
+}
@@ -0,0 +1,257 @@
+/// bamJitter.zig
+/// How long each BAM plane is actually shown, against the lsb_time_us << plane it's meant to get.
+/// TIM15_IRQ hands planeEnd() a SysTick reading as soon as it's entered, so a plane's length is the time
+/// between two of those: the plane's timer period plus however late the interrupt that ends it got in.
+/// A capture fills its buffer once and stops. dump() sends it over uart, and since this only depends on std,
+/// parseDump() and analyze() work the same on a captured log off the cube (zig build bam-jitter).
+const std = @import("std");
+
+/// SysTick counts down through 24 bits, see cycles.zig
+pub const counter_mask: u32 = (1 << 24) - 1;
+pub const cycles_per_us = 48;
+pub const capacity = 512;
+pub const max_planes = 8;
+
+/// One plane going by. plane counts from the scan profile's first plane, so its nominal length is lsb << plane
+pub const Sample = packed struct(u32) {
+    cycles: u24,
+    plane: u8,
+};
+
+pub const Capture = struct {
+    samples: [capacity]Sample = undefined,
+    len: usize = 0,
+    lsb_time_us: u32 = 0,
+    armed: bool = false,
+    /// SysTick at the last interrupt. Null when the next interrupt doesn't end a plane
+    last: ?u32 = null,
+
+    /// SysTick has to be running (cycles.init())
+    pub fn start(self: *Capture, lsb_time_us: u32) void {
+        self.len = 0;
+        self.lsb_time_us = lsb_time_us;
+        self.last = null;
+        self.armed = true;
+    }
+
+    /// Keeps what's been captured so far. From TIM15_IRQ when the scan profile changes
+    pub fn stop(self: *Capture) void {
+        self.armed = false;
+    }
+
+    /// BAM stopped or is starting up, so the next interrupt is the start of a plane only
+    pub fn restart(self: *Capture) void {
+        self.last = null;
+    }
+
+    /// Polled from outside the interrupt that finishes the capture, so it has to actually reread armed
+    pub fn done(self: *const Capture) bool {
+        const armed: *const volatile bool = &self.armed;
+        return !armed.*;
+    }
+
+    /// From TIM15_IRQ as soon as it's entered, with the plane that just ended
+    pub fn planeEnd(self: *Capture, plane: u8, now: u32) void {
+        if (!self.armed) {
+            return;
+        }
+        if (self.last) |last| {
+            self.samples[self.len] = .{ .cycles = @intCast((last -% now) & counter_mask), .plane = plane };
+            self.len += 1;
+            if (self.len == capacity) {
+                self.armed = false;
+            }
+        }
+        self.last = now;
+    }
+
+    pub fn captured(self: *const Capture) []const Sample {
+        return self.samples[0..self.len];
+    }
+
+    /// Hex dump of the little endian samples, since the debug uart turns \n into \r\n
+    pub fn dump(self: *const Capture, writer: anytype) !void {
+        try writer.print("BAM JITTER BEGIN {} {}\n", .{ self.lsb_time_us, self.len });
+        const bytes = std.mem.sliceAsBytes(self.captured());
+        var i: usize = 0;
+        while (i < bytes.len) : (i += 32) {
+            try writer.print("{}\n", .{std.fmt.fmtSliceHexLower(bytes[i..@min(i + 32, bytes.len)])});
+        }
+        try writer.print("BAM JITTER END\n", .{});
+    }
+};
+
+pub var capture = Capture{};
+
+pub const Parsed = struct {
+    lsb_time_us: u32,
+    samples: []Sample,
+};
+
+/// Turns the output of dump() back into samples, filling out
+pub fn parseDump(text: []const u8, out: []Sample) !Parsed {
+    var lines = std.mem.tokenizeAny(u8, text, "\r\n");
+    var lsb: ?u32 = null;
+    var n: usize = 0;
+    while (lines.next()) |line| {
+        if (std.mem.startsWith(u8, line, "BAM JITTER BEGIN ")) {
+            var words = std.mem.tokenizeScalar(u8, line["BAM JITTER BEGIN ".len..], ' ');
+            lsb = try std.fmt.parseInt(u32, words.next() orelse return error.Truncated, 10);
+            n = 0;
+        } else if (std.mem.eql(u8, line, "BAM JITTER END")) {
+            return .{ .lsb_time_us = lsb orelse return error.Truncated, .samples = out[0..n] };
+        } else if (lsb != null) {
+            var word: [4]u8 = undefined;
+            var rest = line;
+            while (rest.len >= 8) : (rest = rest[8..]) {
+                if (n == out.len) {
+                    return error.NoSpaceLeft;
+                }
+                _ = try std.fmt.hexToBytes(&word, rest[0..8]);
+                out[n] = @bitCast(std.mem.readInt(u32, &word, .little));
+                n += 1;
+            }
+        }
+    }
+    return error.Truncated;
+}
+
+/// Distance of a plane from its plane's average, in cycles: 1/4 us, 1 us, 5 us, 10 us, 50 us
+pub const bucket_edges = [_]u32{ 12, 48, 240, 480, 2400 };
+
+pub const PlaneStats = struct {
+    count: u32 = 0,
+    /// lsb_time_us << plane, in cycles
+    nominal: u32 = 0,
+    min: u32 = std.math.maxInt(u32),
+    max: u32 = 0,
+    sum: u64 = 0,
+
+    pub fn avg(self: PlaneStats) u32 {
+        return if (self.count == 0) 0 else @intCast(self.sum / self.count);
+    }
+
+    /// Average minus nominal. The same on every plane means the ISR's fixed cost, which skews the dim planes most
+    pub fn offset(self: PlaneStats) i32 {
+        return @as(i32, @intCast(self.avg())) - @as(i32, @intCast(self.nominal));
+    }
+
+    /// How long the plane really is compared to what it's meant to be, in 1/1000
+    pub fn weightPermille(self: PlaneStats) u32 {
+        return if (self.nominal == 0) 0 else @intCast(@as(u64, self.avg()) * 1000 / self.nominal);
+    }
+};
+
+pub const Report = struct {
+    lsb_time_us: u32,
+    planes: [max_planes]PlaneStats = .{PlaneStats{}} ** max_planes,
+    /// How many planes landed how far from their plane's average, split at bucket_edges
+    histogram: [bucket_edges.len + 1]u32 = .{0} ** (bucket_edges.len + 1),
+    /// Furthest any plane got from its plane's average, in cycles
+    worst: u32 = 0,
+
+    pub fn print(self: *const Report, writer: anytype) !void {
+        try writer.print("BAM plane lengths, lsb {} us (cycles at {} MHz):\n", .{ self.lsb_time_us, cycles_per_us });
+        for (self.planes, 0..) |p, i| {
+            if (p.count == 0) continue;
+            try writer.print("    plane {} n={: >3} nominal={: >7} min={: >7} avg={: >7} max={: >7} offset={: >5} p-p={: >5} weight={}/1000\n", .{
+                i, p.count, p.nominal, p.min, p.avg(), p.max, p.offset(), p.max - p.min, p.weightPermille(),
+            });
+        }
+        try writer.print("    jitter vs plane average:", .{});
+        for (self.histogram, 0..) |count, i| {
+            if (i < bucket_edges.len) {
+                try writer.print(" <{}: {}", .{ bucket_edges[i], count });
+            } else {
+                try writer.print(" more: {}", .{count});
+            }
+        }
+        try writer.print(", worst {}\n", .{self.worst});
+    }
+};
+
+pub fn analyze(samples: []const Sample, lsb_time_us: u32) Report {
+    var report = Report{ .lsb_time_us = lsb_time_us };
+    for (samples) |s| {
+        if (s.plane >= max_planes) continue;
+        const p = &report.planes[s.plane];
+        p.count += 1;
+        p.min = @min(p.min, s.cycles);
+        p.max = @max(p.max, s.cycles);
+        p.sum += s.cycles;
+    }
+    for (&report.planes, 0..) |*p, i| {
+        p.nominal = (lsb_time_us << @intCast(i)) * cycles_per_us;
+    }
+    for (samples) |s| {
+        if (s.plane >= max_planes) continue;
+        const avg = report.planes[s.plane].avg();
+        const off: u32 = if (s.cycles > avg) s.cycles - avg else avg - s.cycles;
+        report.worst = @max(report.worst, off);
+        var bucket: usize = 0;
+        while (bucket < bucket_edges.len and off >= bucket_edges[bucket]) {
+            bucket += 1;
+        }
+        report.histogram[bucket] += 1;
+    }
+    return report;
+}
+
+test "capture and analysis" {
+    var c = Capture{};
+    const lsb: u32 = 10;
+
+    // SysTick counts down. Every plane runs 60 cycles over, one gets hit by a 300 cycle interrupt
+    c.start(lsb);
+    var now: u32 = 1000;
+    c.planeEnd(4, now);
+    for (0..20) |i| {
+        const plane = i % 5;
+        const late: u32 = if (i == 7) 300 else 0;
+        now = (now -% ((lsb << @intCast(plane)) * cycles_per_us + 60 + late)) & counter_mask;
+        c.planeEnd(@intCast(plane), now);
+    }
+    // The first interrupt doesn't end a plane, and the counter wrapped in between
+    try std.testing.expect(c.len == 20);
+    try std.testing.expect(c.samples[0].plane == 0 and c.samples[0].cycles == 480 + 60);
+
+    const r = analyze(c.captured(), lsb);
+    try std.testing.expect(r.planes[0].count == 4 and r.planes[0].nominal == 480);
+    try std.testing.expect(r.planes[2].offset() == 60 + 300 / 4);
+    try std.testing.expect(r.planes[2].max - r.planes[2].min == 300);
+    try std.testing.expect(r.planes[1].weightPermille() == 1000 * (960 + 60) / 960);
+    try std.testing.expect(r.worst == 300 - 300 / 4);
+    // 16 spot on, 3 planes 75 cycles under their average, 1 225 over
+    try std.testing.expect(r.histogram[0] == 16 and r.histogram[2] == 4);
+
+    // After restart() the next interrupt only starts a plane
+    c.restart();
+    c.planeEnd(0, 5000);
+    try std.testing.expect(c.len == 20);
+}
+
+test "uart format round trip" {
+    var c = Capture{};
+    c.start(10);
+    c.planeEnd(1, 3000);
+    c.planeEnd(0, 3000 - 540);
+    c.planeEnd(1, 3000 - 540 - 1600);
+    var text: [256]u8 = undefined;
+    var stream = std.io.fixedBufferStream(&text);
+    try c.dump(stream.writer());
+    var fromDump: [4]Sample = undefined;
+    const dumped = try parseDump(stream.getWritten(), &fromDump);
+    try std.testing.expectEqual(@as(u32, 10), dumped.lsb_time_us);
+    try std.testing.expectEqualSlices(u8, std.mem.sliceAsBytes(c.captured()), std.mem.sliceAsBytes(dumped.samples));
+
+    var out: [4]Sample = undefined;
+    const parsed = try parseDump(
+        \\noise
+        \\BAM JITTER BEGIN 10 2
+        \\1c02000040060001
+        \\BAM JITTER END
+    , &out);
+    try std.testing.expect(parsed.lsb_time_us == 10 and parsed.samples.len == 2);
+    try std.testing.expect(parsed.samples[0].cycles == 540 and parsed.samples[0].plane == 0);
+    try std.testing.expect(parsed.samples[1].cycles == 1600 and parsed.samples[1].plane == 1);
+}
@@ -0,0 +1,37 @@
+/// cycles.zig
+/// Cycle counting with SysTick, since the M0 has no DWT cycle counter.
+/// SysTick free-runs at the core clock (48 MHz), counting down through 24 bits,
+/// so anything up to ~349 ms can be timed exactly.
+/// Nothing else uses SysTick, so it just gets left running once init() is called.
+const cmsis = @import("../cImport.zig").cmsis;
+
+pub const wrap: u32 = 1 << 24;
+
+/// Cost of a measure() around nothing, taken off every measurement
+var overhead: u32 = 0;
+
+pub fn init() void {
+    cmsis.SysTick.*.LOAD = wrap - 1;
+    cmsis.SysTick.*.VAL = 0;
+    cmsis.SysTick.*.CTRL = cmsis.SysTick_CTRL_CLKSOURCE_Msk | cmsis.SysTick_CTRL_ENABLE_Msk;
+    overhead = 0;
+    overhead = measure(nothing, .{});
+}
+
+pub inline fn now() u32 {
+    return cmsis.SysTick.*.VAL;
+}
+
+/// Cycles from start (a now() reading) until now
+pub inline fn since(start: u32) u32 {
+    return (start -% now()) & (wrap - 1);
+}
+
+/// Calls f once and returns how many cycles it took
+pub fn measure(comptime f: anytype, args: anytype) u32 {
+    const start = now();
+    @call(.never_inline, f, args);
+    return since(start) -| overhead;
+}
+
+fn nothing() void {}
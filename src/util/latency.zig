@@ -0,0 +1,259 @@
+/// latency.zig
+/// Input-to-photon latency bookkeeping.
+/// The debounce interrupt feeds in every raw sample, so each accepted edge gets stamped with the sample
+/// its final run of highs started on (the last bounce), not the one that finally filled the debounce byte.
+/// When an app reads that edge it moves onto the next frame, which carries the newest edge it consumed.
+/// The matrix driver calls shown() from the DMA interrupt once that frame has been scanned onto every layer.
+/// Three rolling windows come out of it:
+///     input: edge -> app read it (debounce depth + the app's polling loop)
+///     display: app read it -> frame on the cube (drawing, render()/renderBAM(), BAM cycle alignment and one scan)
+///     total: edge -> frame on the cube
+/// Only depends on std. Callers hand in the time, in TIM3 milliseconds (deltaTime.millis()).
+const std = @import("std");
+const builtin = @import("builtin");
+const Source = @import("trace.zig").Source;
+
+/// TIM3 counts up through 16 bits, so only that much of a stamp means anything
+pub const stamp_mask: u32 = 0xFFFF;
+/// Never a real stamp, marks an empty slot. A single word, so the interrupt can't tear it
+const none: u32 = std.math.maxInt(u32);
+
+pub fn elapsed(from: u32, to: u32) u32 {
+    return (to -% from) & stamp_mask;
+}
+
+/// Only the cube has interrupts to keep out, on the host these do nothing
+const on_cube = builtin.cpu.arch == .thumb;
+
+/// Masks interrupts, returning PRIMASK as it was so nested sections don't unmask early
+fn enterCritical() u32 {
+    if (!on_cube) {
+        return 0;
+    }
+    var primask: u32 = undefined;
+    asm volatile (
+        \\mrs %[primask], primask
+        \\cpsid i
+        : [primask] "=r" (primask),
+        :
+        : "memory"
+    );
+    return primask;
+}
+
+fn leaveCritical(primask: u32) void {
+    if (!on_cube) {
+        return;
+    }
+    asm volatile ("msr primask, %[primask]"
+        :
+        : [primask] "r" (primask),
+        : "memory"
+    );
+}
+
+/// Laid out for C as well, see LatencyStats in application.h
+pub const Summary = extern struct {
+    count: u32 = 0,
+    min: u32 = 0,
+    avg: u32 = 0,
+    p99: u32 = 0,
+    max: u32 = 0,
+};
+
+/// The last `size` samples, in ms
+pub fn Window(comptime size: usize) type {
+    return struct {
+        const Self = @This();
+
+        samples: [size]u16 = undefined,
+        len: usize = 0,
+        next: usize = 0,
+
+        pub fn add(self: *Self, ms: u32) void {
+            self.samples[self.next] = @intCast(@min(ms, std.math.maxInt(u16)));
+            self.next = (self.next + 1) % size;
+            self.len = @min(self.len + 1, size);
+        }
+
+        pub fn reset(self: *Self) void {
+            self.len = 0;
+            self.next = 0;
+        }
+
+        /// Sorts a copy, so it's for reporting and not for every frame
+        pub fn summary(self: *const Self) Summary {
+            if (self.len == 0) {
+                return .{};
+            }
+            var sorted: [size]u16 = undefined;
+            const used = sorted[0..self.len];
+            @memcpy(used, self.samples[0..self.len]);
+            std.mem.sort(u16, used, {}, std.sort.asc(u16));
+            var sum: u32 = 0;
+            for (used) |s| {
+                sum += s;
+            }
+            // Nearest rank
+            const rank = (self.len * 99 + 99) / 100;
+            return .{
+                .count = @intCast(self.len),
+                .min = used[0],
+                .avg = sum / @as(u32, @intCast(self.len)),
+                .p99 = used[rank - 1],
+                .max = used[self.len - 1],
+            };
+        }
+    };
+}
+
+pub const window_size = 128;
+const source_count = @typeInfo(Source).Enum.fields.len;
+
+/// What a frame carries from the newest edge drawn into it
+pub const FrameStamp = struct {
+    captured: u32,
+    consumed: u32,
+};
+
+/// Every field has one context that writes it, so a more urgent interrupt landing mid-update can't tear anything:
+///     PendSV (sample(), capture()): level, runStart, and filling captured
+///     app (consume(), submit()): clearing captured (interrupts masked), pending, input
+///     DMA interrupt (shown()): display, total
+/// The app reads display and total for reports and reset()s them, which at worst gives a report one sample off.
+pub const Tracker = struct {
+    /// Level of each source at its last sample. PendSV
+    level: [source_count]bool = .{false} ** source_count,
+    /// When each source's current run of highs began. PendSV
+    runStart: [source_count]u32 = .{0} ** source_count,
+    /// Edges debounce accepted that the app hasn't read yet. Filled in PendSV, cleared by the app
+    captured: [source_count]u32 = .{none} ** source_count,
+    /// Newest edge read since the last frame was handed over. App
+    pending: ?FrameStamp = null,
+
+    input: Window(window_size) = .{},
+    display: Window(window_size) = .{},
+    total: Window(window_size) = .{},
+
+    /// Every raw debounce sample. From the debounce interrupt
+    pub fn sample(self: *Tracker, source: Source, high: bool, now: u32) void {
+        const i = @intFromEnum(source);
+        if (high and !self.level[i]) {
+            self.runStart[i] = now & stamp_mask;
+        }
+        self.level[i] = high;
+    }
+
+    /// Debounce accepted an edge on source. From the debounce interrupt
+    pub fn capture(self: *Tracker, source: Source) void {
+        const i = @intFromEnum(source);
+        self.captured[i] = self.runStart[i];
+    }
+
+    /// The app asked for an edge on source. Passes edge through, so it can wrap the existing return values
+    pub fn consume(self: *Tracker, source: Source, edge: bool, now: u32) bool {
+        if (!edge) {
+            return edge;
+        }
+        const i = @intFromEnum(source);
+        // capture() runs in PendSV and could land between the read and the clear, losing that edge
+        const primask = enterCritical();
+        const captured = self.captured[i];
+        self.captured[i] = none;
+        leaveCritical(primask);
+        if (captured == none) {
+            // Replayed, or accepted before tracking started
+            return edge;
+        }
+        const stamp = now & stamp_mask;
+        self.input.add(elapsed(captured, stamp));
+        if (self.pending) |p| {
+            if (elapsed(p.captured, stamp) < elapsed(captured, stamp)) {
+                return edge;
+            }
+        }
+        self.pending = .{ .captured = captured, .consumed = stamp };
+        return edge;
+    }
+
+    /// A frame got handed to the driver. Returns what it carries, for shown()
+    pub fn submit(self: *Tracker) ?FrameStamp {
+        const out = self.pending;
+        self.pending = null;
+        return out;
+    }
+
+    /// The frame has been scanned onto every layer once. From the DMA interrupt
+    pub fn shown(self: *Tracker, stamp: ?FrameStamp, now: u32) void {
+        const s = stamp orelse return;
+        self.display.add(elapsed(s.consumed, now & stamp_mask));
+        self.total.add(elapsed(s.captured, now & stamp_mask));
+    }
+
+    pub fn reset(self: *Tracker) void {
+        self.input.reset();
+        self.display.reset();
+        self.total.reset();
+    }
+
+    pub fn printReport(self: *const Tracker, writer: anytype) !void {
+        try writer.print("Input latency over the last {} edges (ms):\n", .{window_size});
+        inline for (.{ "input", "display", "total" }) |name| {
+            const s = @field(self, name).summary();
+            try writer.print("    {s: <8} n={: >3} min={: >4} avg={: >4} p99={: >4} max={: >4}\n", .{ name, s.count, s.min, s.avg, s.p99, s.max });
+        }
+    }
+};
+
+pub var tracker = Tracker{};
+
+test "edge to frame on the cube" {
+    var t = Tracker{};
+
+    // Bounce at 10 ms, settles at 15, debounce accepts at 32. App reads it at 40, the frame's on the cube at 52
+    t.sample(.button_a, true, 10);
+    t.sample(.button_a, false, 12);
+    t.sample(.button_a, true, 15);
+    t.sample(.button_a, true, 17);
+    t.capture(.button_a);
+    try std.testing.expect(!t.consume(.button_a, false, 35));
+    try std.testing.expect(t.consume(.button_a, true, 40));
+    // Read once, so a second edge without a capture doesn't count
+    try std.testing.expect(t.consume(.button_a, true, 41));
+    try std.testing.expect(t.input.len == 1);
+    const stamp = t.submit();
+    try std.testing.expect(t.submit() == null);
+    t.shown(stamp, 52);
+    try std.testing.expect(t.input.summary().max == 25);
+    try std.testing.expect(t.display.summary().max == 12);
+    try std.testing.expect(t.total.summary().max == 37);
+
+    // Frames without input don't add samples
+    t.shown(t.submit(), 60);
+    try std.testing.expect(t.total.len == 1);
+}
+
+test "newest of two edges rides the frame, across the TIM3 wrap" {
+    var t = Tracker{};
+    t.sample(.joystick_left, true, 0xFFF0);
+    t.capture(.joystick_left);
+    t.sample(.joystick_up, true, 0x0004);
+    t.capture(.joystick_up);
+    _ = t.consume(.joystick_up, true, 0x0008);
+    _ = t.consume(.joystick_left, true, 0x0009);
+    const newest = t.submit().?;
+    try std.testing.expect(newest.captured == 0x0004);
+    try std.testing.expect(elapsed(0xFFF0, 0x0009) == 0x19);
+}
+
+test "rolling window stats" {
+    var w = Window(100){};
+    for (1..251) |i| {
+        w.add(@intCast(i));
+    }
+    const s = w.summary();
+    try std.testing.expect(s.count == 100);
+    try std.testing.expect(s.min == 151 and s.max == 250);
+    try std.testing.expect(s.p99 == 249);
+    try std.testing.expect(s.avg == 200);
+}
@@ -0,0 +1,109 @@
+/// layerRing.zig
+/// Handoff logic for streaming the cube one layer at a time ("racing the beam").
+/// Two layer slots sit back to back in a circular DMA transfer. When DMA finishes reading one slot
+/// (half transfer for slot 0, transfer complete for slot 1), that slot gets refilled with the next layer
+/// while the other one shifts out. So a frame never has to exist in memory all at once,
+/// and each layer is produced right before it's shown.
+/// Only depends on std and is generic over the layer type, so it runs the same against a simulated DMA.
+const std = @import("std");
+
+pub fn LayerRing(comptime Layer: type) type {
+    return struct {
+        const Self = @This();
+
+        /// Fills in layer z's data. layerId is already set. Runs in the DMA interrupt,
+        /// so it has to finish before the other slot is done shifting
+        pub const Producer = *const fn (z: u3, layer: *Layer) void;
+
+        /// What the DMA streams. Slot 0 is the first half of the transfer
+        slots: [2]Layer = undefined,
+        producer: Producer,
+        /// Layer the next refill produces
+        next: u3 = 0,
+        /// Times both slots were done before we got to either, so a slot went out twice
+        overruns: u32 = 0,
+        /// Whole frames (8 layers) produced so far
+        frames: u32 = 0,
+
+        /// Fills both slots with the first two layers. Call before starting the DMA
+        pub fn prime(self: *Self) void {
+            self.next = 0;
+            self.fill(0);
+            self.fill(1);
+        }
+
+        /// Call from the DMA interrupt with the half transfer and transfer complete flags
+        pub fn dmaEvent(self: *Self, half: bool, complete: bool) void {
+            if (half and complete) {
+                // DMA is already back in slot 0, only slot 1 can be written safely.
+                // Slot 0 shows its old layer again and the layer order catches up on the next pass
+                self.overruns += 1;
+                self.fill(1);
+            } else if (half) {
+                self.fill(0);
+            } else if (complete) {
+                self.fill(1);
+            }
+        }
+
+        fn fill(self: *Self, slot: u1) void {
+            const z = self.next;
+            const layer = &self.slots[slot];
+            // NOTE: hardware inverted z, same as FrameBuffer
+            layer.layerId = 7 - @as(u8, z);
+            self.producer(z, layer);
+            self.next +%= 1;
+            if (self.next == 0) {
+                self.frames += 1;
+            }
+        }
+    };
+}
+
+// Simulated DMA
+const Sim = struct {
+    const Layer = extern struct {
+        layerId: u8,
+        srs: [24]u8,
+    };
+
+    fn produce(z: u3, layer: *Layer) void {
+        layer.srs = .{@as(u8, z) * 9 + 1} ** 24;
+    }
+};
+
+test "ring keeps up with the DMA" {
+    const Ring = LayerRing(Sim.Layer);
+    var ring = Ring{ .producer = Sim.produce };
+    ring.prime();
+
+    // 4 frames worth of slots. DMA reads slot i % 2, then flags that half as done
+    for (0..32) |i| {
+        const slot = i % 2;
+        const shown = ring.slots[slot];
+        const z = i % 8;
+        try std.testing.expect(shown.layerId == 7 - z);
+        try std.testing.expect(std.mem.allEqual(u8, &shown.srs, @as(u8, @intCast(z)) * 9 + 1));
+        ring.dmaEvent(slot == 0, slot == 1);
+    }
+    try std.testing.expectEqual(@as(u32, 4), ring.frames);
+    try std.testing.expectEqual(@as(u32, 0), ring.overruns);
+}
+
+test "ring survives a missed half" {
+    const Ring = LayerRing(Sim.Layer);
+    var ring = Ring{ .producer = Sim.produce };
+    ring.prime();
+
+    // Missing a half: slot 0 repeats its layer, slot 1 carries on, nothing gets torn
+    ring.dmaEvent(true, true);
+    try std.testing.expectEqual(@as(u32, 1), ring.overruns);
+    try std.testing.expectEqual(@as(u8, 7 - 0), ring.slots[0].layerId);
+    try std.testing.expectEqual(@as(u8, 7 - 2), ring.slots[1].layerId);
+    try std.testing.expect(std.mem.allEqual(u8, &ring.slots[1].srs, 2 * 9 + 1));
+
+    // Back in step afterwards
+    ring.dmaEvent(true, false);
+    try std.testing.expectEqual(@as(u8, 7 - 3), ring.slots[0].layerId);
+    try std.testing.expect(std.mem.allEqual(u8, &ring.slots[0].srs, 3 * 9 + 1));
+}
@@ -0,0 +1,599 @@
+/// trace.zig
+/// Deterministic record & replay of everything an app reads from the outside world.
+/// While recording, every hooked input (debounced button & joystick edges, DeltaTime.milli() results,
+/// timestamp() seeds, and raw IMU burst reads) is appended to a compact binary trace,
+/// along with a CRC of every rendered frame.
+/// While replaying, the same hooks hand back the recorded values instead of the live ones,
+/// and every rendered frame is checked against its recorded CRC.
+/// Apps are deterministic given their inputs, so the hooks get hit in exactly the order they were recorded.
+/// Only depends on std, so traces dumped over uart can be decoded and replayed off the cube as well (replay.zig).
+/// Apps busy-poll DeltaTime.milli() and mostly get 0 back, so a run of zeros is stored as a count on the next time
+/// record rather than one record each. A polling loop costs a couple of bytes per millisecond that way instead of dozens.
+const std = @import("std");
+
+/// Things that produce debounced edges
+pub const Source = enum(u5) {
+    joystick_button,
+    joystick_left,
+    joystick_right,
+    joystick_up,
+    joystick_down,
+    button_a,
+    button_b,
+};
+
+const Kind = enum(u3) {
+    /// arg: Source. No payload, only edges that were actually seen are stored
+    input,
+    /// A DeltaTime.milli() result. arg: the result + 1 if it's below 31, otherwise 0.
+    /// Varint payload: how many 0 results came right before this one, then the result if it didn't fit in arg
+    time,
+    /// varint payload: a timestamp() result, which apps use to seed their PRNGs
+    seed,
+    /// arg: byte count. Payload: raw bytes from the IMU
+    imu,
+    /// 4 byte little endian payload: CRC32 of the rendered frame
+    frame,
+    end,
+    _,
+};
+
+/// Biggest time that fits in a Tag's arg
+const short_time = 30;
+
+/// Every record starts with one of these
+const Tag = packed struct(u8) {
+    arg: u5 = 0,
+    kind: Kind,
+};
+
+pub const magic = "CUBT";
+pub const version: u8 = 2;
+/// Magic, version, app index, name length, then the name
+const header_len = magic.len + 3;
+/// Longer app names get cut short in the header
+pub const max_name = 32;
+
+pub const Mode = enum { off, record, replay };
+
+pub const Record = union(enum) {
+    input: Source,
+    time: u32,
+    seed: u32,
+    imu: []const u8,
+    frame: u32,
+    end,
+};
+
+pub const DecodeError = error{ BadHeader, Truncated, BadRecord };
+
+/// Walks the records of a trace. Used by replay, and usable as-is on the host.
+pub const Reader = struct {
+    data: []const u8,
+    pos: usize,
+    app: u8,
+    /// The app's name in the menu, what replay.zig goes by since the index depends on the build
+    name: []const u8,
+    /// 0 times still to hand out before afterZeros
+    zeros: u32 = 0,
+    afterZeros: u32 = 0,
+
+    pub fn init(data: []const u8) DecodeError!Reader {
+        if (data.len < header_len or !std.mem.eql(u8, data[0..magic.len], magic) or data[magic.len] != version) {
+            return DecodeError.BadHeader;
+        }
+        const nameLen = data[magic.len + 2];
+        if (data.len < header_len + nameLen) {
+            return DecodeError.BadHeader;
+        }
+        return .{
+            .data = data,
+            .pos = header_len + nameLen,
+            .app = data[magic.len + 1],
+            .name = data[header_len..][0..nameLen],
+        };
+    }
+
+    pub fn next(self: *Reader) DecodeError!Record {
+        if (self.zeros > 0) {
+            self.zeros -= 1;
+            return .{ .time = if (self.zeros == 0) self.afterZeros else 0 };
+        }
+        if (self.pos >= self.data.len) {
+            return DecodeError.Truncated;
+        }
+        const tag: Tag = @bitCast(self.data[self.pos]);
+        self.pos += 1;
+        switch (tag.kind) {
+            .input => return .{ .input = std.meta.intToEnum(Source, tag.arg) catch return DecodeError.BadRecord },
+            .time => {
+                const zeros = try self.varint();
+                const t = if (tag.arg == 0) try self.varint() else tag.arg - 1;
+                if (zeros == 0) {
+                    return .{ .time = t };
+                }
+                self.zeros = zeros;
+                self.afterZeros = t;
+                return .{ .time = 0 };
+            },
+            .seed => return .{ .seed = try self.varint() },
+            .imu => {
+                const bytes = try self.take(tag.arg);
+                return .{ .imu = bytes };
+            },
+            .frame => return .{ .frame = std.mem.readInt(u32, (try self.take(4))[0..4], .little) },
+            .end => return .end,
+            _ => return DecodeError.BadRecord,
+        }
+    }
+
+    fn take(self: *Reader, n: usize) DecodeError![]const u8 {
+        if (self.pos + n > self.data.len) {
+            return DecodeError.Truncated;
+        }
+        defer self.pos += n;
+        return self.data[self.pos..][0..n];
+    }
+
+    // LEB128
+    fn varint(self: *Reader) DecodeError!u32 {
+        var out: u32 = 0;
+        var shift: u6 = 0;
+        while (shift < 35) : (shift += 7) {
+            const byte = (try self.take(1))[0];
+            out |= @as(u32, @truncate(@as(u64, byte & 0x7f) << shift));
+            if (byte & 0x80 == 0) {
+                return out;
+            }
+        }
+        return DecodeError.BadRecord;
+    }
+};
+
+// ------
+// State
+// ------
+/// Biggest trace recorded() can hand out
+pub const capacity = 6 * 1024;
+var buffer: [capacity]u8 = undefined;
+var len: usize = 0;
+var mode: Mode = .off;
+var reader: Reader = undefined;
+
+/// Recording ran out of space. The trace is still valid, it just ends early
+var overflowed = false;
+/// 0 times recorded since the last time record, see Kind.time
+var pendingZeros: u32 = 0;
+/// Replay hit a record that doesn't match what the app asked for. Live inputs were used from then on
+var desynced = false;
+var framesSeen: u32 = 0;
+var frameMismatches: u32 = 0;
+
+pub fn getMode() Mode {
+    return mode;
+}
+
+pub const Stats = struct {
+    frames: u32,
+    frameMismatches: u32,
+    desynced: bool,
+    overflowed: bool,
+};
+
+/// How the current or last recording/replay went
+pub fn stats() Stats {
+    return .{ .frames = framesSeen, .frameMismatches = frameMismatches, .desynced = desynced, .overflowed = overflowed };
+}
+
+/// app is the index of the app about to run, name its name in the menu
+pub fn startRecording(app: u8, name: []const u8) void {
+    const nameLen = @min(name.len, max_name);
+    @memcpy(buffer[0..magic.len], magic);
+    buffer[magic.len] = version;
+    buffer[magic.len + 1] = app;
+    buffer[magic.len + 2] = @intCast(nameLen);
+    @memcpy(buffer[header_len..][0..nameLen], name[0..nameLen]);
+    len = header_len + nameLen;
+    overflowed = false;
+    pendingZeros = 0;
+    framesSeen = 0;
+    mode = .record;
+}
+
+/// data must stay valid until stop(). The last recording (recorded()) is fine to pass in.
+/// app is the index of the app about to run, which has to be the one the trace was recorded from.
+pub fn startReplay(data: []const u8, app: u8) (DecodeError || error{WrongApp})!void {
+    const newReader = try Reader.init(data);
+    if (newReader.app != app) {
+        return error.WrongApp;
+    }
+    reader = newReader;
+    desynced = false;
+    framesSeen = 0;
+    frameMismatches = 0;
+    mode = .replay;
+}
+
+/// Ends the recording or replay. Check overflowed in what it hands back after recording:
+/// a trace that ran out of space only covers the start of the session
+pub fn stop() Stats {
+    if (mode == .record) {
+        flushZeros();
+    }
+    end();
+    return stats();
+}
+
+fn end() void {
+    if (mode == .record) {
+        // append() always leaves a byte for this
+        buffer[len] = @bitCast(Tag{ .kind = .end });
+        len += 1;
+    }
+    mode = .off;
+}
+
+/// The most recent recording, header and all
+pub fn recorded() []const u8 {
+    return buffer[0..len];
+}
+
+// --------------------
+// Hooks for subsystems
+// --------------------
+
+/// Call with the result of a debounced edge poll. Returns what the app should see.
+pub fn input(source: Source, live: bool) bool {
+    switch (mode) {
+        .off => return live,
+        .record => {
+            if (live) {
+                put(.{ .kind = .input, .arg = @intFromEnum(source) }, &.{});
+            }
+            return live;
+        },
+        .replay => {
+            // Edges are only stored when they happened, so anything else at the head means "not yet"
+            var ahead = reader;
+            const rec = ahead.next() catch return false;
+            if (rec == .input and rec.input == source) {
+                reader = ahead;
+                return true;
+            }
+            return false;
+        },
+    }
+}
+
+/// Call with the result of a DeltaTime.milli() call
+pub fn time(live: u32) u32 {
+    switch (mode) {
+        .off => return live,
+        .record => {
+            if (live == 0) {
+                pendingZeros += 1;
+            } else {
+                putTime(live, pendingZeros);
+            }
+            return live;
+        },
+        .replay => {
+            const rec = expect(.time) orelse return live;
+            return rec.time;
+        },
+    }
+}
+
+/// Call with a timestamp() that is about to be used as a seed
+pub fn seed(live: u32) u32 {
+    switch (mode) {
+        .off => return live,
+        .record => {
+            var payload: [5]u8 = undefined;
+            put(.{ .kind = .seed }, payload[0..writeVarint(&payload, live)]);
+            return live;
+        },
+        .replay => {
+            const rec = expect(.seed) orelse return live;
+            return rec.seed;
+        },
+    }
+}
+
+/// Call after a raw IMU read into dest. In replay dest gets overwritten with the recorded bytes.
+pub fn imu(dest: []u8) void {
+    switch (mode) {
+        .off => {},
+        .record => put(.{ .kind = .imu, .arg = @intCast(dest.len) }, dest),
+        .replay => {
+            const rec = expect(.imu) orelse return;
+            if (rec.imu.len != dest.len) {
+                return desync();
+            }
+            @memcpy(dest, rec.imu);
+        },
+    }
+}
+
+/// Call with the frame data right before it gets shown
+pub fn frame(data: []const u8) void {
+    if (mode == .off) {
+        return;
+    }
+    const crc = std.hash.Crc32.hash(data);
+    framesSeen += 1;
+    switch (mode) {
+        .off => unreachable,
+        .record => {
+            var payload: [4]u8 = undefined;
+            std.mem.writeInt(u32, &payload, crc, .little);
+            put(.{ .kind = .frame }, &payload);
+        },
+        .replay => {
+            const rec = expect(.frame) orelse return;
+            if (rec.frame != crc) {
+                frameMismatches += 1;
+            }
+        },
+    }
+}
+
+const RecordKind = std.meta.Tag(Record);
+
+/// LEB128, returns the bytes used
+fn writeVarint(out: *[5]u8, v: u32) usize {
+    var n: usize = 0;
+    var rest = v;
+    while (rest >= 0x80) : (rest >>= 7) {
+        out[n] = @as(u8, @truncate(rest)) | 0x80;
+        n += 1;
+    }
+    out[n] = @truncate(rest);
+    return n + 1;
+}
+
+/// t, after zeros 0 times
+fn putTime(t: u32, zeros: u32) void {
+    pendingZeros = 0;
+    var payload: [10]u8 = undefined;
+    var n = writeVarint(payload[0..5], zeros);
+    if (t > short_time) {
+        n += writeVarint(payload[n..][0..5], t);
+    }
+    append(.{ .kind = .time, .arg = if (t > short_time) 0 else @intCast(t + 1) }, payload[0..n]);
+}
+
+/// Zeros have to go in before any other record, or replay would hand them out in the wrong order
+fn flushZeros() void {
+    if (pendingZeros > 0) {
+        // n zeros is n - 1 zeros, then a 0
+        putTime(0, pendingZeros - 1);
+    }
+}
+
+/// Pops the next record if it's the kind we want. Otherwise gives up on the replay
+fn expect(comptime kind: RecordKind) ?Record {
+    const rec = reader.next() catch {
+        desync();
+        return null;
+    };
+    if (rec != kind) {
+        desync();
+        return null;
+    }
+    return rec;
+}
+
+fn desync() void {
+    desynced = true;
+    mode = .off;
+}
+
+fn put(tag: Tag, payload: []const u8) void {
+    flushZeros();
+    if (mode == .record) {
+        append(tag, payload);
+    }
+}
+
+/// Appends one whole record or nothing. Always leaves room for the end tag
+fn append(tag: Tag, payload: []const u8) void {
+    if (len + 1 + payload.len > capacity - 1) {
+        overflowed = true;
+        end();
+        return;
+    }
+    buffer[len] = @bitCast(tag);
+    @memcpy(buffer[len + 1 ..][0..payload.len], payload);
+    len += 1 + payload.len;
+}
+
+// -----------
+// Uart output
+// -----------
+
+/// Hex dump, since the debug uart turns \n into \r\n
+pub fn dump(writer: anytype) !void {
+    try writer.print("TRACE BEGIN {}\n", .{len});
+    var i: usize = 0;
+    while (i < len) : (i += 32) {
+        try writer.print("{}\n", .{std.fmt.fmtSliceHexLower(buffer[i..@min(i + 32, len)])});
+    }
+    try writer.print("TRACE END\n", .{});
+}
+
+/// Turns the output of dump() back into trace bytes. Returns the slice of out that was filled.
+pub fn parseDump(text: []const u8, out: []u8) ![]u8 {
+    var lines = std.mem.tokenizeAny(u8, text, "\r\n");
+    var n: usize = 0;
+    var inTrace = false;
+    while (lines.next()) |line| {
+        if (std.mem.startsWith(u8, line, "TRACE BEGIN")) {
+            inTrace = true;
+        } else if (std.mem.eql(u8, line, "TRACE END")) {
+            return out[0..n];
+        } else if (inTrace) {
+            const bytes = try std.fmt.hexToBytes(out[n..], line);
+            n += bytes.len;
+        }
+    }
+    return error.Truncated;
+}
+
+pub fn printSummary(writer: anytype) !void {
+    try writer.print("Trace: {} bytes, {} frames", .{ len, framesSeen });
+    if (overflowed) {
+        try writer.print(", ran out of space", .{});
+    }
+    if (frameMismatches > 0 or desynced) {
+        try writer.print(", {} frame mismatches{s}", .{ frameMismatches, if (desynced) ", desynced" else "" });
+    }
+    try writer.print("\n", .{});
+}
+
+// -----
+// Tests
+// -----
+
+/// A tiny deterministic "app": polls two buttons, reads the time and the IMU, and renders a frame from them
+fn fakeApp(steps: usize, presses: []const usize) void {
+    var state: u32 = seed(1234);
+    var raw = [_]u8{ 1, 2, 3, 4, 5, 6 };
+    for (0..steps) |i| {
+        const pressed = std.mem.indexOfScalar(usize, presses, i) != null;
+        if (input(.button_a, pressed)) {
+            state +%= 17;
+        }
+        if (input(.button_b, false)) {
+            state +%= 1;
+        }
+        state +%= time(@intCast(i * 3));
+        raw[0] +%= 1;
+        imu(&raw);
+        state +%= raw[0];
+        frame(std.mem.asBytes(&state));
+    }
+}
+
+test "replay reproduces every frame" {
+    startRecording(3, "Fake");
+    fakeApp(40, &.{ 2, 9, 30 });
+    try std.testing.expectEqual(Stats{ .frames = 40, .frameMismatches = 0, .desynced = false, .overflowed = false }, stop());
+
+    try std.testing.expectError(error.WrongApp, startReplay(recorded(), 4));
+    try startReplay(recorded(), 3);
+    // Live inputs say nothing's pressed, the trace says otherwise
+    fakeApp(40, &.{});
+    const s = stop();
+    try std.testing.expectEqual(@as(u32, 40), s.frames);
+    try std.testing.expectEqual(@as(u32, 0), s.frameMismatches);
+    try std.testing.expect(!s.desynced);
+}
+
+test "replay counts frames that differ" {
+    startRecording(0, "Fake");
+    frame("abc");
+    frame("def");
+    _ = stop();
+    try startReplay(recorded(), 0);
+    frame("abc");
+    frame("xyz");
+    const s = stop();
+    try std.testing.expectEqual(@as(u32, 1), s.frameMismatches);
+    try std.testing.expect(!s.desynced);
+}
+
+test "replay gives up when the app asks for something else" {
+    startRecording(0, "Fake");
+    _ = time(5);
+    _ = stop();
+    try startReplay(recorded(), 0);
+    try std.testing.expectEqual(@as(u32, 77), seed(77));
+    try std.testing.expect(stats().desynced);
+    try std.testing.expectEqual(Mode.off, getMode());
+    // From here on it's live inputs
+    try std.testing.expectEqual(@as(u32, 9), time(9));
+}
+
+test "dump round trip" {
+    startRecording(2, "Dump");
+    _ = seed(0xdeadbeef);
+    _ = time(300);
+    frame("frame");
+    _ = stop();
+
+    var text: [1024]u8 = undefined;
+    var stream = std.io.fixedBufferStream(&text);
+    try stream.writer().print("boot noise\n", .{});
+    try dump(stream.writer());
+
+    var out: [capacity]u8 = undefined;
+    const parsed = try parseDump(stream.getWritten(), &out);
+    try std.testing.expectEqualSlices(u8, recorded(), parsed);
+
+    var r = try Reader.init(parsed);
+    try std.testing.expectEqual(@as(u8, 2), r.app);
+    try std.testing.expectEqualStrings("Dump", r.name);
+    try std.testing.expectEqual(@as(u32, 0xdeadbeef), (try r.next()).seed);
+    try std.testing.expectEqual(@as(u32, 300), (try r.next()).time);
+    try std.testing.expectEqual(std.hash.Crc32.hash("frame"), (try r.next()).frame);
+    try std.testing.expect(try r.next() == .end);
+}
+
+test "running out of space still leaves a whole trace" {
+    startRecording(0, "Fake");
+    var i: u32 = 0;
+    while (getMode() == .record) : (i += 1) {
+        _ = time(0x7fff_ffff);
+    }
+    try std.testing.expect(stats().overflowed);
+    var r = try Reader.init(recorded());
+    var times: u32 = 0;
+    while (true) {
+        switch (try r.next()) {
+            .time => times += 1,
+            .end => break,
+            else => return error.TestUnexpectedResult,
+        }
+    }
+    // The one that didn't fit isn't in there
+    try std.testing.expectEqual(i - 1, times);
+}
+
+test "polling for time costs a couple of bytes a millisecond" {
+    // What a loop around DeltaTime.milli() sees: mostly nothing, now and then a tick
+    var expected: [3010]u32 = undefined;
+    for (&expected, 0..) |*t, i| {
+        t.* = if (i % 50 == 49) 1 else if (i == 1234) 400 else 0;
+    }
+    startRecording(0, "Fake");
+    for (expected[0..2010]) |t| {
+        _ = time(t);
+    }
+    // Zeros still waiting for a time record go in ahead of anything else
+    frame("f");
+    for (expected[2010..]) |t| {
+        _ = time(t);
+    }
+    // Trailing zeros too
+    try std.testing.expect(!stop().overflowed);
+    try std.testing.expect(recorded().len < 200);
+
+    var r = try Reader.init(recorded());
+    for (expected[0..2010]) |t| {
+        try std.testing.expectEqual(t, (try r.next()).time);
+    }
+    try std.testing.expectEqual(std.hash.Crc32.hash("f"), (try r.next()).frame);
+    for (expected[2010..]) |t| {
+        try std.testing.expectEqual(t, (try r.next()).time);
+    }
+    try std.testing.expect(try r.next() == .end);
+}
+
+test "names longer than the header allows get cut" {
+    startRecording(1, "x" ** (max_name + 10));
+    _ = stop();
+    var r = try Reader.init(recorded());
+    try std.testing.expectEqualStrings("x" ** max_name, r.name);
+    try std.testing.expect(try r.next() == .end);
+}
@@ -0,0 +1,28 @@
+/// bamJitterReport.zig
+/// Prints the BAM jitter report from a uart log with a capture dump in it (see apps/bamTest.zig).
+/// Usage: zig build bam-jitter -- uart.log, or pipe the log into stdin
+const std = @import("std");
+const BamJitter = @import("bamJitter");
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const args = try std.process.argsAlloc(allocator);
+    defer std.process.argsFree(allocator, args);
+    const max_log = 16 * 1024 * 1024;
+    const text = if (args.len > 1)
+        try std.fs.cwd().readFileAlloc(allocator, args[1], max_log)
+    else
+        try std.io.getStdIn().readToEndAlloc(allocator, max_log);
+    defer allocator.free(text);
+
+    var samples: [BamJitter.capacity]BamJitter.Sample = undefined;
+    const parsed = BamJitter.parseDump(text, &samples) catch |err| {
+        std.log.err("no complete BAM JITTER dump in the log ({s})", .{@errorName(err)});
+        std.process.exit(1);
+    };
+    const stdout = std.io.getStdOut().writer();
+    try BamJitter.analyze(parsed.samples, parsed.lsb_time_us).print(stdout);
+}
@@ -0,0 +1,183 @@
+/// benchM0.zig
+/// The benchKernels.zig kernels built for thumbv6m and run under QEMU's micro:bit machine, which is a Cortex-M0:
+/// Thumb-1 only, no hardware divide, no FPU, like the cube. zig build bench-m0 runs it, no board needed.
+/// QEMU gets -icount, so every instruction moves the virtual clock on by the same amount, and SysTick,
+/// which runs off that clock, counts instructions (see calibrate()). Counts are good to an instruction or so.
+/// Results go out over semihosting, one line per kernel, for tools/benchM0Report.zig to add the
+/// code sizes from the ELF and check them against the baseline.
+const std = @import("std");
+const Kernels = @import("kernels");
+
+const runs = 4;
+
+// ---------
+// Startup
+// ---------
+
+// From benchM0.ld
+extern var _stack_top: u8;
+extern var _sdata: u8;
+extern var _edata: u8;
+extern var _sidata: u8;
+extern var _sbss: u8;
+extern var _ebss: u8;
+
+const Handler = *const fn () callconv(.C) void;
+const VectorTable = extern struct {
+    initial_sp: *u8,
+    reset: *const fn () callconv(.C) noreturn,
+    /// NMI up to SysTick
+    exceptions: [14]?Handler,
+};
+
+export const vector_table: VectorTable linksection(".vectors") = .{
+    .initial_sp = &_stack_top,
+    .reset = &benchReset,
+    .exceptions = [2]?Handler{ &fault, &fault } ++ [_]?Handler{null} ** 11 ++ [1]?Handler{&sysTickIrq},
+};
+
+export fn benchReset() callconv(.C) noreturn {
+    const data_len = @intFromPtr(&_edata) - @intFromPtr(&_sdata);
+    @memcpy(@as([*]u8, @ptrCast(&_sdata))[0..data_len], @as([*]const u8, @ptrCast(&_sidata))[0..data_len]);
+    const bss_len = @intFromPtr(&_ebss) - @intFromPtr(&_sbss);
+    @memset(@as([*]u8, @ptrCast(&_sbss))[0..bss_len], 0);
+
+    run();
+    exit(true);
+}
+
+fn fault() callconv(.C) void {
+    print("fault\n", .{});
+    exit(false);
+}
+
+pub fn panic(msg: []const u8, _: ?*std.builtin.StackTrace, _: ?usize) noreturn {
+    print("panic: {s}\n", .{msg});
+    exit(false);
+}
+
+// ---------
+// Semihosting
+// ---------
+
+const SYS_WRITE0 = 0x04;
+const SYS_EXIT = 0x18;
+const ADP_Stopped_ApplicationExit = 0x20026;
+const ADP_Stopped_RunTimeErrorUnknown = 0x20023;
+
+fn semihost(op: u32, arg: usize) usize {
+    return asm volatile ("bkpt #0xab"
+        : [ret] "={r0}" (-> usize),
+        : [op] "{r0}" (op),
+          [arg] "{r1}" (arg),
+        : "memory"
+    );
+}
+
+/// QEMU exits with 0 for a clean exit, 1 otherwise
+fn exit(ok: bool) noreturn {
+    _ = semihost(SYS_EXIT, if (ok) ADP_Stopped_ApplicationExit else ADP_Stopped_RunTimeErrorUnknown);
+    while (true) {}
+}
+
+fn print(comptime fmt: []const u8, args: anytype) void {
+    var buf: [128]u8 = undefined;
+    const line = std.fmt.bufPrintZ(&buf, fmt, args) catch return;
+    _ = semihost(SYS_WRITE0, @intFromPtr(line.ptr));
+}
+
+// ---------
+// Counting
+// ---------
+
+const SysTick = struct {
+    const ctrl: *volatile u32 = @ptrFromInt(0xE000E010);
+    const load: *volatile u32 = @ptrFromInt(0xE000E014);
+    const val: *volatile u32 = @ptrFromInt(0xE000E018);
+    const wrap: u32 = 1 << 24;
+};
+
+/// SysTick wraps, this counts them so kernels of any length can be timed
+var wrapsRaw: u32 = 0;
+const wraps: *volatile u32 = &wrapsRaw;
+
+fn sysTickIrq() callconv(.C) void {
+    wraps.* +%= 1;
+}
+
+fn startTicks() void {
+    SysTick.load.* = SysTick.wrap - 1;
+    SysTick.val.* = 0;
+    // Core clock, interrupt on wrap, on
+    SysTick.ctrl.* = 0b111;
+}
+
+/// Ticks since startTicks()
+fn ticks() u64 {
+    while (true) {
+        const before = wraps.*;
+        const down = SysTick.val.*;
+        // Retry if it wrapped in between
+        if (wraps.* == before) {
+            return @as(u64, before) * SysTick.wrap + (SysTick.wrap - 1 - down);
+        }
+    }
+}
+
+/// Exactly 2 instructions a lap
+fn spin(laps: u32) void {
+    _ = asm volatile (
+        \\1:
+        \\ subs r0, #1
+        \\ bne 1b
+        : [left] "={r0}" (-> u32),
+        : [laps] "{r0}" (laps),
+        : "cc"
+    );
+}
+
+fn measure(comptime f: anytype, args: anytype) u64 {
+    const start = ticks();
+    @call(.never_inline, f, args);
+    return ticks() - start;
+}
+
+fn nothing() void {}
+
+const calibration_laps = 1 << 19;
+const calibration_rounds = 16;
+/// Instructions the calibration is over
+const calibration_instructions: u64 = 2 * calibration_laps * calibration_rounds;
+
+/// Ticks per calibration_instructions instructions. Doubling the laps and taking the difference leaves
+/// out the call, the SysTick reads and everything else that isn't the loop.
+/// QEMU's micro:bit runs SysTick at 16 MHz, so with -icount shift=7 (128 ns an instruction) that's 2.048 ticks
+/// an instruction. Nothing relies on that number though, it's measured here.
+fn calibrate() u64 {
+    var total: u64 = 0;
+    for (0..calibration_rounds) |_| {
+        total += measure(spin, .{2 * calibration_laps}) - measure(spin, .{calibration_laps});
+    }
+    return total;
+}
+
+fn instructions(measuredTicks: u64, calibration: u64) u64 {
+    return (measuredTicks * calibration_instructions + calibration / 2) / calibration;
+}
+
+fn run() void {
+    startTicks();
+    const calibration = calibrate();
+    const overhead = measure(nothing, .{});
+    print("calibration {} ticks per {} instructions\n", .{ calibration, calibration_instructions });
+
+    inline for (Kernels.kernels) |kernel| {
+        var best: u64 = std.math.maxInt(u64);
+        for (0..runs) |_| {
+            best = @min(best, measure(kernel.run, .{}) -| overhead);
+        }
+        // The address is how the report finds the kernel's code in the ELF
+        print("kernel 0x{x:0>8} {} {s}\n", .{ @intFromPtr(kernel.run), instructions(best, calibration), kernel.name });
+    }
+    print("done\n", .{});
+}
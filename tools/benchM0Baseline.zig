@@ -0,0 +1,6 @@
+/// benchM0Baseline.zig
+/// What zig build bench-m0 checks against: instructions for each kernel's fastest run and the bytes of code
+/// it reaches, ReleaseSmall thumbv6m under QEMU. Written by zig build bench-m0 -- --record,
+/// re-record it whenever a change is meant to cost instructions or flash.
+pub const Baseline = struct { name: []const u8, instructions: u64, bytes: u32 };
+pub const baseline = [_]Baseline{};
@@ -0,0 +1,280 @@
+/// benchM0Report.zig
+/// The other half of zig build bench-m0: reads what tools/benchM0.zig printed under QEMU, works out each kernel's
+/// code size from the ELF, and checks both against benchM0Baseline.zig. Exits with 1 if anything got more than
+/// `tolerance_pct` bigger or slower, if a kernel has no baseline, or if the run didn't finish.
+/// A kernel's size is every function it can reach through BL and B, compiler-rt helpers included,
+/// since on the M0 those (division mostly) are part of what a kernel costs. Calls through pointers aren't followed.
+/// Usage: bench-m0-report bench-m0.elf qemu.out benchM0Baseline.zig [--record]
+/// --record rewrites the baseline with this run instead of checking it.
+const std = @import("std");
+const Baseline = @import("benchM0Baseline.zig");
+
+/// Instruction counts don't vary from run to run in QEMU, so this only has to cover rounding
+const tolerance_pct = 2;
+
+const Result = struct {
+    name: []const u8,
+    instructions: u64,
+    bytes: u32,
+};
+
+const Verdict = enum { ok, new, regressed };
+
+// ---------
+// ELF
+// ---------
+
+const Elf = struct {
+    bytes: []const u8,
+    /// Start address (Thumb bit cleared) to size, for every FUNC symbol
+    functions: std.AutoHashMap(u32, u32),
+
+    fn read(comptime T: type, bytes: []const u8, offset: usize) !T {
+        if (offset + @sizeOf(T) > bytes.len) {
+            return error.Truncated;
+        }
+        return std.mem.bytesToValue(T, bytes[offset..][0..@sizeOf(T)]);
+    }
+
+    fn section(self: *const Elf, index: usize) !std.elf.Elf32_Shdr {
+        const header = try read(std.elf.Elf32_Ehdr, self.bytes, 0);
+        if (index >= header.e_shnum) {
+            return error.Truncated;
+        }
+        return read(std.elf.Elf32_Shdr, self.bytes, header.e_shoff + index * header.e_shentsize);
+    }
+
+    fn load(allocator: std.mem.Allocator, bytes: []const u8) !Elf {
+        if (bytes.len < std.elf.EI_NIDENT or !std.mem.eql(u8, bytes[0..4], std.elf.MAGIC) or
+            bytes[std.elf.EI_CLASS] != std.elf.ELFCLASS32 or bytes[std.elf.EI_DATA] != std.elf.ELFDATA2LSB)
+        {
+            return error.NotThumbElf;
+        }
+        var self = Elf{ .bytes = bytes, .functions = std.AutoHashMap(u32, u32).init(allocator) };
+        errdefer self.functions.deinit();
+
+        const header = try read(std.elf.Elf32_Ehdr, bytes, 0);
+        for (0..header.e_shnum) |i| {
+            const symtab = try self.section(i);
+            if (symtab.sh_type != std.elf.SHT_SYMTAB) {
+                continue;
+            }
+            var offset: usize = symtab.sh_offset;
+            while (offset + @sizeOf(std.elf.Elf32_Sym) <= symtab.sh_offset + symtab.sh_size) : (offset += @sizeOf(std.elf.Elf32_Sym)) {
+                const sym = try read(std.elf.Elf32_Sym, bytes, offset);
+                if (sym.st_info & 0xf != std.elf.STT_FUNC or sym.st_size == 0) {
+                    continue;
+                }
+                // Aliases share an address, keep the one that covers the most
+                const entry = try self.functions.getOrPut(sym.st_value & ~@as(u32, 1));
+                entry.value_ptr.* = if (entry.found_existing) @max(entry.value_ptr.*, sym.st_size) else sym.st_size;
+            }
+        }
+        if (self.functions.count() == 0) {
+            return error.NoSymbols;
+        }
+        return self;
+    }
+
+    fn deinit(self: *Elf) void {
+        self.functions.deinit();
+    }
+
+    /// The bytes at address..address + len, out of whichever code section holds them
+    fn code(self: *const Elf, address: u32, len: u32) ?[]const u8 {
+        const header = read(std.elf.Elf32_Ehdr, self.bytes, 0) catch return null;
+        for (0..header.e_shnum) |i| {
+            const s = self.section(i) catch return null;
+            if (s.sh_type != std.elf.SHT_PROGBITS or s.sh_flags & std.elf.SHF_EXECINSTR == 0) {
+                continue;
+            }
+            if (address >= s.sh_addr and address + len <= s.sh_addr + s.sh_size) {
+                const start = s.sh_offset + (address - s.sh_addr);
+                if (start + len > self.bytes.len) {
+                    return null;
+                }
+                return self.bytes[start..][0..len];
+            }
+        }
+        return null;
+    }
+
+    /// Bytes of the function at entry and of every function it can branch to, each counted once
+    fn reachableBytes(self: *const Elf, allocator: std.mem.Allocator, entry: u32) !u32 {
+        var seen = std.AutoHashMap(u32, void).init(allocator);
+        defer seen.deinit();
+        var todo = std.ArrayList(u32).init(allocator);
+        defer todo.deinit();
+
+        try todo.append(entry & ~@as(u32, 1));
+        var total: u32 = 0;
+        while (todo.popOrNull()) |start| {
+            if ((try seen.getOrPut(start)).found_existing) {
+                continue;
+            }
+            const size = self.functions.get(start) orelse continue;
+            total += size;
+            const body = self.code(start, size) orelse continue;
+            var i: u32 = 0;
+            while (i + 2 <= body.len) {
+                const branch = decodeBranch(body[i..], start + i);
+                if (branch.target) |target| {
+                    // Only whole functions count, which also skips branches inside this one
+                    // and literal pool words that happen to decode as a branch
+                    if (self.functions.contains(target)) {
+                        try todo.append(target);
+                    }
+                }
+                i += branch.len;
+            }
+        }
+        return total;
+    }
+};
+
+const Branch = struct { target: ?u32, len: u32 };
+
+/// Decodes the Thumb instruction at code[0] as far as telling a BL or an unconditional B from anything else.
+/// pc is code[0]'s address
+fn decodeBranch(code: []const u8, pc: u32) Branch {
+    const hw1 = std.mem.readInt(u16, code[0..2], .little);
+    // B, T2 encoding: 11100 imm11
+    if (hw1 & 0xF800 == 0xE000) {
+        const offset: i32 = @as(i11, @bitCast(@as(u11, @truncate(hw1))));
+        return .{ .target = pc +% 4 +% @as(u32, @bitCast(offset * 2)), .len = 2 };
+    }
+    // BL: 11110 S imm10, then 11 J1 1 J2 imm11
+    if (hw1 & 0xF800 == 0xF000 and code.len >= 4) {
+        const hw2 = std.mem.readInt(u16, code[2..4], .little);
+        if (hw2 & 0xD000 != 0xD000) {
+            return .{ .target = null, .len = 2 };
+        }
+        const s: u32 = (hw1 >> 10) & 1;
+        const i1 = ~(((hw2 >> 13) & 1) ^ s) & 1;
+        const i2 = ~(((hw2 >> 11) & 1) ^ s) & 1;
+        const imm: u25 = @truncate((s << 24) | (i1 << 23) | (i2 << 22) | (@as(u32, hw1 & 0x3FF) << 12) | (@as(u32, hw2 & 0x7FF) << 1));
+        const offset: i32 = @as(i25, @bitCast(imm));
+        return .{ .target = pc +% 4 +% @as(u32, @bitCast(offset)), .len = 4 };
+    }
+    return .{ .target = null, .len = 2 };
+}
+
+// ---------
+// Report
+// ---------
+
+fn judge(result: Result) Verdict {
+    for (Baseline.baseline) |b| {
+        if (std.mem.eql(u8, b.name, result.name)) {
+            const slower = result.instructions * 100 > b.instructions * (100 + tolerance_pct);
+            const bigger = @as(u64, result.bytes) * 100 > @as(u64, b.bytes) * (100 + tolerance_pct);
+            return if (slower or bigger) .regressed else .ok;
+        }
+    }
+    return .new;
+}
+
+/// Same form as the baseline table
+fn printResult(writer: anytype, result: Result) !void {
+    try writer.print("    .{{ .name = \"{s}\", .instructions = {}, .bytes = {} }},", .{ result.name, result.instructions, result.bytes });
+}
+
+fn record(path: []const u8, results: []const Result) !void {
+    const file = try std.fs.cwd().createFile(path, .{});
+    defer file.close();
+    var buffered = std.io.bufferedWriter(file.writer());
+    const writer = buffered.writer();
+    try writer.writeAll(
+        \\/// benchM0Baseline.zig
+        \\/// What zig build bench-m0 checks against: instructions for each kernel's fastest run and the bytes of code
+        \\/// it reaches, ReleaseSmall thumbv6m under QEMU. Written by zig build bench-m0 -- --record,
+        \\/// re-record it whenever a change is meant to cost instructions or flash.
+        \\pub const Baseline = struct { name: []const u8, instructions: u64, bytes: u32 };
+        \\pub const baseline = [_]Baseline{
+        \\
+    );
+    for (results) |result| {
+        try printResult(writer, result);
+        try writer.writeAll("\n");
+    }
+    try writer.writeAll("};\n");
+    try buffered.flush();
+}
+
+pub fn main() !u8 {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const args = try std.process.argsAlloc(allocator);
+    defer std.process.argsFree(allocator, args);
+    if (args.len < 4) {
+        std.log.err("usage: {s} bench-m0.elf qemu.out benchM0Baseline.zig [--record]", .{args[0]});
+        return 1;
+    }
+    const recording = args.len > 4 and std.mem.eql(u8, args[4], "--record");
+
+    const elf_bytes = try std.fs.cwd().readFileAlloc(allocator, args[1], 16 * 1024 * 1024);
+    defer allocator.free(elf_bytes);
+    var elf = Elf.load(allocator, elf_bytes) catch |err| {
+        std.log.err("can't read the functions out of {s} ({s})", .{ args[1], @errorName(err) });
+        return 1;
+    };
+    defer elf.deinit();
+
+    const text = try std.fs.cwd().readFileAlloc(allocator, args[2], 1024 * 1024);
+    defer allocator.free(text);
+
+    var results = std.ArrayList(Result).init(allocator);
+    defer results.deinit();
+    var finished = false;
+    var lines = std.mem.tokenizeAny(u8, text, "\r\n");
+    while (lines.next()) |line| {
+        if (std.mem.eql(u8, line, "done")) {
+            finished = true;
+        } else if (std.mem.startsWith(u8, line, "kernel ")) {
+            // kernel <address> <instructions> <name>
+            var words = std.mem.tokenizeScalar(u8, line["kernel ".len..], ' ');
+            const address = try std.fmt.parseInt(u32, words.next() orelse return error.Truncated, 0);
+            const instructions = try std.fmt.parseInt(u64, words.next() orelse return error.Truncated, 10);
+            try results.append(.{
+                .name = std.mem.trim(u8, words.rest(), " "),
+                .instructions = instructions,
+                .bytes = try elf.reachableBytes(allocator, address),
+            });
+        } else if (!std.mem.startsWith(u8, line, "calibration ")) {
+            // Panics and faults
+            std.log.err("{s}", .{line});
+        }
+    }
+    if (!finished) {
+        std.log.err("the benchmark run didn't finish", .{});
+        return 1;
+    }
+
+    if (recording) {
+        try record(args[3], results.items);
+        std.log.info("recorded {} kernels into {s}", .{ results.items.len, args[3] });
+        return 0;
+    }
+
+    const stdout = std.io.getStdOut().writer();
+    var regressed = false;
+    var missing = false;
+    for (results.items) |result| {
+        const verdict = judge(result);
+        regressed = regressed or verdict == .regressed;
+        missing = missing or verdict == .new;
+        try printResult(stdout, result);
+        try stdout.print(" // {s}\n", .{switch (verdict) {
+            .ok => "ok",
+            .regressed => "REGRESSION",
+            .new => "NO BASELINE",
+        }});
+    }
+    // A kernel without a baseline can't be checked, so that fails too
+    if (missing) {
+        std.log.err("some kernels have no baseline, zig build bench-m0 -- --record adds them", .{});
+    }
+    return if (regressed or missing) 1 else 0;
+}
@@ -0,0 +1,41 @@
+/// replayTrace.zig
+/// Replays a trace from a uart log (the TRACE BEGIN ... TRACE END dump a debug build prints after recording)
+/// against the app logic on Linux, and exits with 1 if any frame came out different or the replay desynced.
+/// Usage: zig build replay -- uart.log, or pipe the log into stdin
+const std = @import("std");
+const Replay = @import("replay");
+const Trace = Replay.Trace;
+
+pub fn main() !u8 {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const args = try std.process.argsAlloc(allocator);
+    defer std.process.argsFree(allocator, args);
+    const max_log = 16 * 1024 * 1024;
+    const text = if (args.len > 1)
+        try std.fs.cwd().readFileAlloc(allocator, args[1], max_log)
+    else
+        try std.io.getStdIn().readToEndAlloc(allocator, max_log);
+    defer allocator.free(text);
+
+    var bytes: [Trace.capacity]u8 = undefined;
+    const data = Trace.parseDump(text, &bytes) catch |err| {
+        std.log.err("no complete TRACE dump in the log ({s})", .{@errorName(err)});
+        return 1;
+    };
+    const stats = Replay.replay(data) catch |err| {
+        std.log.err("can't replay that trace ({s})", .{@errorName(err)});
+        return 1;
+    };
+
+    const stdout = std.io.getStdOut().writer();
+    try stdout.print("Replayed {} bytes: {} frames, {} mismatches{s}\n", .{
+        data.len,
+        stats.frames,
+        stats.frameMismatches,
+        if (stats.desynced) ", desynced" else "",
+    });
+    return if (stats.frameMismatches == 0 and !stats.desynced) 0 else 1;
+}